@@ -32,7 +32,7 @@ As long as this comment is preserved at the top of the file
 using namespace std;
 
 #include "matrix.h"
-#include "ThreadPool.h"
+#include "threadPool.h"
 
 using Time = double;
 extern Time systemTime;
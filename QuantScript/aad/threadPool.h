@@ -18,6 +18,9 @@ As long as this comment is preserved at the top of the file
 
 //  Thread pool of chapter 3
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <future>
 #include <thread>
 #include "ConcurrentQueue.h"
@@ -41,8 +44,8 @@ class ThreadPool
     //  Active indicator
     bool myActive;
 
-	//	Interruption indicator
-	bool myInterrupt;
+	//	Interruption indicator, read by the worker threads
+	atomic<bool> myInterrupt;
 
 	//	Thread number
 	static thread_local size_t myTLSNum;
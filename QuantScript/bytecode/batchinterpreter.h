@@ -0,0 +1,247 @@
+#pragma once
+#include "bytecode/bytecode.h"
+#include "models/models.h"
+#include "config.hpp"
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+namespace QuantScript
+{
+    // Runs a compiled Program over N paths at once, every register holds N contiguous lanes
+    // so that arithmetic loops vectorize. IF blocks run under lane masks and are skipped
+    // entirely when no lane takes them. Only supports double, AAD goes through BytecodeEvaluator.
+    template <size_t N>
+    class BatchEvaluator
+    {
+        using Mask = int64_t;
+
+        const Program *myProgram;
+        std::vector<double> myRegisters;
+        std::vector<Mask> myBools;
+        // myMasks[d] is the active mask at nesting depth d, myConds[d] the condition that opened depth d + 1
+        std::vector<Mask> myMasks;
+        std::vector<Mask> myConds;
+        size_t myDepth = 0;
+
+        double *reg(uint32_t i) { return myRegisters.data() + i * N; }
+        Mask *breg(uint32_t i) { return myBools.data() + i * N; }
+        Mask *mask() { return &myMasks[myDepth * N]; }
+        static bool anyActive(const Mask *m)
+        {
+            Mask acc = 0;
+            for (size_t l = 0; l < N; ++l)
+                acc |= m[l];
+            return acc != 0;
+        }
+
+        // Write f(lane) into register dst, variables are only written on active lanes
+        template <class F>
+        void store(uint32_t dst, F f)
+        {
+            double *d = reg(dst);
+            if (myDepth > 0 && dst < myProgram->numVariables)
+            {
+                const Mask *m = mask();
+                for (size_t l = 0; l < N; ++l)
+                {
+                    const double v = f(l);
+                    d[l] = m[l] ? v : d[l];
+                }
+            }
+            else
+            {
+                for (size_t l = 0; l < N; ++l)
+                    d[l] = f(l);
+            }
+        }
+        template <class F>
+        void storeBool(uint32_t dst, F f)
+        {
+            Mask *d = breg(dst);
+            for (size_t l = 0; l < N; ++l)
+                d[l] = f(l) ? Mask(-1) : Mask(0);
+        }
+
+    public:
+        BatchEvaluator(const Program &program)
+            : myProgram(&program), myRegisters(program.numRegisters * N), myBools(program.numBoolRegisters * N)
+        {
+            size_t depth = 0, maxDepth = 0;
+            for (auto &ins : program.instructions)
+            {
+                if (ins.op == OpCode::If)
+                    maxDepth = std::max(maxDepth, ++depth);
+                else if (ins.op == OpCode::EndIf)
+                    --depth;
+            }
+            myMasks.resize((maxDepth + 1) * N);
+            myConds.resize(maxDepth * N);
+        };
+
+        // (Re-)initialize before evaluation of each batch
+        void init()
+        {
+            const size_t nVar = myProgram->numVariables;
+            std::fill(myRegisters.begin(), myRegisters.begin() + nVar * N, 0.0);
+            for (size_t i = 0; i < myProgram->constants.size(); ++i)
+                std::fill_n(reg(static_cast<uint32_t>(nVar + i)), N, myProgram->constants[i]);
+            std::fill_n(myMasks.begin(), N, Mask(-1));
+            myDepth = 0;
+        }
+
+        // Value of variable v on a given lane
+        double varVal(size_t v, size_t lane) const
+        {
+            return myRegisters[v * N + lane];
+        };
+        // Add the lane sums of all variables to sums
+        void sumVarVals(std::vector<double> &sums) const
+        {
+            for (size_t v = 0; v < myProgram->numVariables; ++v)
+            {
+                double s = 0.0;
+                for (size_t l = 0; l < N; ++l)
+                    s += myRegisters[v * N + l];
+                sums[v] += s;
+            }
+        };
+
+        void evaluate(const ScenarioBatch<N> &batch)
+        {
+            const Instruction *code = myProgram->instructions.data();
+
+            for (size_t event = 0; event < myProgram->numEvents(); ++event)
+            {
+                const double *spot = &batch.spots[event * N];
+                const double *num = &batch.numeraires[event * N];
+                const size_t end = myProgram->eventStart[event + 1];
+                for (size_t pc = myProgram->eventStart[event]; pc < end; ++pc)
+                {
+                    const Instruction &ins = code[pc];
+                    const double *a = reg(ins.lhs);
+                    const double *b = reg(ins.rhs);
+                    switch (ins.op)
+                    {
+                    case OpCode::Move:
+                        store(ins.dst, [=](size_t l) { return a[l]; });
+                        break;
+                    case OpCode::Neg:
+                        store(ins.dst, [=](size_t l) { return -a[l]; });
+                        break;
+                    case OpCode::Add:
+                        store(ins.dst, [=](size_t l) { return a[l] + b[l]; });
+                        break;
+                    case OpCode::Subtract:
+                        store(ins.dst, [=](size_t l) { return a[l] - b[l]; });
+                        break;
+                    case OpCode::Mult:
+                        store(ins.dst, [=](size_t l) { return a[l] * b[l]; });
+                        break;
+                    case OpCode::Div:
+                        store(ins.dst, [=](size_t l) { return a[l] / b[l]; });
+                        break;
+                    case OpCode::Pow:
+                        store(ins.dst, [=](size_t l) { return std::pow(a[l], b[l]); });
+                        break;
+                    case OpCode::Log:
+                        store(ins.dst, [=](size_t l) { return std::log(a[l]); });
+                        break;
+                    case OpCode::Sqrt:
+                        store(ins.dst, [=](size_t l) { return std::sqrt(a[l]); });
+                        break;
+                    case OpCode::Max:
+                        store(ins.dst, [=](size_t l) { return a[l] > b[l] ? a[l] : b[l]; });
+                        break;
+                    case OpCode::Min:
+                        store(ins.dst, [=](size_t l) { return a[l] < b[l] ? a[l] : b[l]; });
+                        break;
+                    case OpCode::Spot:
+                        store(ins.dst, [=](size_t l) { return spot[l]; });
+                        break;
+                    case OpCode::Solver:
+                    {
+                        const double value = *myProgram->solverValues[ins.lhs];
+                        store(ins.dst, [=](size_t l) { return value; });
+                        break;
+                    }
+                    case OpCode::Pays:
+                    {
+                        const double *d = reg(ins.dst);
+                        store(ins.dst, [=](size_t l) { return d[l] + a[l] / num[l]; });
+                        break;
+                    }
+
+                    case OpCode::Equal:
+                        storeBool(ins.dst, [=](size_t l) { return std::fabs(a[l] - b[l]) < EPS; });
+                        break;
+                    case OpCode::Different:
+                        storeBool(ins.dst, [=](size_t l) { return std::fabs(a[l] - b[l]) > EPS; });
+                        break;
+                    case OpCode::Superior:
+                        storeBool(ins.dst, [=](size_t l) { return a[l] > b[l] + EPS; });
+                        break;
+                    case OpCode::SupEqual:
+                        storeBool(ins.dst, [=](size_t l) { return a[l] > b[l] - EPS; });
+                        break;
+                    case OpCode::Inferior:
+                        storeBool(ins.dst, [=](size_t l) { return a[l] < b[l] - EPS; });
+                        break;
+                    case OpCode::InfEqual:
+                        storeBool(ins.dst, [=](size_t l) { return a[l] < b[l] + EPS; });
+                        break;
+                    case OpCode::And:
+                    {
+                        const Mask *x = breg(ins.lhs), *y = breg(ins.rhs);
+                        Mask *d = breg(ins.dst);
+                        for (size_t l = 0; l < N; ++l)
+                            d[l] = x[l] & y[l];
+                        break;
+                    }
+                    case OpCode::Or:
+                    {
+                        const Mask *x = breg(ins.lhs), *y = breg(ins.rhs);
+                        Mask *d = breg(ins.dst);
+                        for (size_t l = 0; l < N; ++l)
+                            d[l] = x[l] | y[l];
+                        break;
+                    }
+
+                    case OpCode::If:
+                    {
+                        const Mask *cond = breg(ins.lhs);
+                        const Mask *outer = mask();
+                        Mask *saved = &myConds[myDepth * N];
+                        ++myDepth;
+                        Mask *inner = mask();
+                        for (size_t l = 0; l < N; ++l)
+                        {
+                            saved[l] = cond[l];
+                            inner[l] = outer[l] & cond[l];
+                        }
+                        // No lane takes the true branch: land on ELSE or ENDIF
+                        if (!anyActive(inner))
+                            pc = ins.rhs - 1;
+                        break;
+                    }
+                    case OpCode::Else:
+                    {
+                        const Mask *outer = &myMasks[(myDepth - 1) * N];
+                        const Mask *cond = &myConds[(myDepth - 1) * N];
+                        Mask *inner = mask();
+                        for (size_t l = 0; l < N; ++l)
+                            inner[l] = outer[l] & ~cond[l];
+                        // No lane takes the false branch: land on ENDIF
+                        if (!anyActive(inner))
+                            pc = ins.rhs - 1;
+                        break;
+                    }
+                    case OpCode::EndIf:
+                        --myDepth;
+                        break;
+                    }
+                }
+            }
+        }
+    };
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace QuantScript
+{
+    // Instruction set of the register machine.
+    // Numeric registers are laid out as [variables | constants | temporaries],
+    // boolean registers only hold temporaries.
+    enum class OpCode : uint32_t
+    {
+        // Numeric: dst = f(lhs, rhs)
+        Move,
+        Neg,
+        Add,
+        Subtract,
+        Mult,
+        Div,
+        Pow,
+        Log,
+        Sqrt,
+        Max,
+        Min,
+        Spot,   // dst = spot on current event
+        Solver, // dst = *solverValues[lhs]
+        Pays,   // dst += lhs / numeraire on current event
+
+        // Boolean: bool dst = f(lhs, rhs)
+        Equal,
+        Different,
+        Superior,
+        SupEqual,
+        Inferior,
+        InfEqual,
+        And,
+        Or,
+
+        // Control flow, rhs holds the jump target
+        If,    // if !bool lhs, jump past target (ELSE or ENDIF)
+        Else,  // jump past target (ENDIF)
+        EndIf, // no-op, closes the block
+    };
+
+    struct Instruction
+    {
+        OpCode op;
+        uint32_t dst;
+        uint32_t lhs;
+        uint32_t rhs;
+    };
+
+    // Compiled product: one linear instruction stream,
+    // event i runs instructions [eventStart[i], eventStart[i + 1])
+    struct Program
+    {
+        std::vector<Instruction> instructions;
+        std::vector<size_t> eventStart;
+        std::vector<double> constants;
+        std::vector<const double *> solverValues;
+        size_t numVariables = 0;
+        size_t numRegisters = 0;
+        size_t numBoolRegisters = 0;
+
+        size_t numEvents() const { return eventStart.empty() ? 0 : eventStart.size() - 1; }
+        size_t firstConstant() const { return numVariables; }
+    };
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include "bytecode/bytecode.h"
+#include "models/models.h"
+#include "config.hpp"
+#include <cmath>
+#include <algorithm>
+
+namespace QuantScript
+{
+    // Dispatch loop over a compiled Program, one scenario at a time
+    template <class T>
+    class BytecodeEvaluator
+    {
+        const Program *myProgram;
+        std::vector<T> myRegisters;
+        std::vector<char> myBools;
+
+    public:
+        BytecodeEvaluator(const Program &program)
+            : myProgram(&program), myRegisters(program.numRegisters), myBools(program.numBoolRegisters) {};
+
+        // (Re-)initialize before evaluation in each scenario
+        void init()
+        {
+            const size_t nVar = myProgram->numVariables;
+            for (size_t i = 0; i < nVar; ++i)
+                myRegisters[i] = 0.0;
+            for (size_t i = 0; i < myProgram->constants.size(); ++i)
+                myRegisters[nVar + i] = myProgram->constants[i];
+        }
+
+        std::vector<T> varVals() const
+        {
+            return std::vector<T>(myRegisters.begin(), myRegisters.begin() + myProgram->numVariables);
+        };
+
+        void evaluate(const Scenario<T> &scenario)
+        {
+            const Instruction *code = myProgram->instructions.data();
+            T *r = myRegisters.data();
+            char *b = myBools.data();
+
+            for (size_t event = 0; event < myProgram->numEvents(); ++event)
+            {
+                const size_t end = myProgram->eventStart[event + 1];
+                for (size_t pc = myProgram->eventStart[event]; pc < end; ++pc)
+                {
+                    const Instruction &ins = code[pc];
+                    switch (ins.op)
+                    {
+                    case OpCode::Move:
+                        r[ins.dst] = r[ins.lhs];
+                        break;
+                    case OpCode::Neg:
+                        r[ins.dst] = -r[ins.lhs];
+                        break;
+                    case OpCode::Add:
+                        r[ins.dst] = r[ins.lhs] + r[ins.rhs];
+                        break;
+                    case OpCode::Subtract:
+                        r[ins.dst] = r[ins.lhs] - r[ins.rhs];
+                        break;
+                    case OpCode::Mult:
+                        r[ins.dst] = r[ins.lhs] * r[ins.rhs];
+                        break;
+                    case OpCode::Div:
+                        r[ins.dst] = r[ins.lhs] / r[ins.rhs];
+                        break;
+                    case OpCode::Pow:
+                        r[ins.dst] = pow(r[ins.lhs], r[ins.rhs]);
+                        break;
+                    case OpCode::Log:
+                        r[ins.dst] = log(r[ins.lhs]);
+                        break;
+                    case OpCode::Sqrt:
+                        r[ins.dst] = sqrt(r[ins.lhs]);
+                        break;
+                    case OpCode::Max:
+                        r[ins.dst] = std::max(r[ins.lhs], r[ins.rhs]);
+                        break;
+                    case OpCode::Min:
+                        r[ins.dst] = std::min(r[ins.lhs], r[ins.rhs]);
+                        break;
+                    case OpCode::Spot:
+                        r[ins.dst] = scenario.spot(event);
+                        break;
+                    case OpCode::Solver:
+                        r[ins.dst] = *myProgram->solverValues[ins.lhs];
+                        break;
+                    case OpCode::Pays:
+                        r[ins.dst] += r[ins.lhs] / scenario.numeraire(event);
+                        break;
+
+                    case OpCode::Equal:
+                        b[ins.dst] = fabs(r[ins.lhs] - r[ins.rhs]) < EPS;
+                        break;
+                    case OpCode::Different:
+                        b[ins.dst] = fabs(r[ins.lhs] - r[ins.rhs]) > EPS;
+                        break;
+                    case OpCode::Superior:
+                        b[ins.dst] = r[ins.lhs] > r[ins.rhs] + EPS;
+                        break;
+                    case OpCode::SupEqual:
+                        b[ins.dst] = r[ins.lhs] > r[ins.rhs] - EPS;
+                        break;
+                    case OpCode::Inferior:
+                        b[ins.dst] = r[ins.lhs] < r[ins.rhs] - EPS;
+                        break;
+                    case OpCode::InfEqual:
+                        b[ins.dst] = r[ins.lhs] < r[ins.rhs] + EPS;
+                        break;
+                    case OpCode::And:
+                        b[ins.dst] = b[ins.lhs] && b[ins.rhs];
+                        break;
+                    case OpCode::Or:
+                        b[ins.dst] = b[ins.lhs] || b[ins.rhs];
+                        break;
+
+                    case OpCode::If:
+                        if (!b[ins.lhs])
+                            pc = ins.rhs;
+                        break;
+                    case OpCode::Else:
+                        pc = ins.rhs;
+                        break;
+                    case OpCode::EndIf:
+                        break;
+                    }
+                }
+            }
+        }
+    };
+}
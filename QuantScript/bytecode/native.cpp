@@ -0,0 +1,102 @@
+#include "native.h"
+#include "visitors/codegen.h"
+#include "others/hash.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <unistd.h>
+#endif
+
+namespace QuantScript
+{
+    std::string NativeModule::defaultCommand()
+    {
+        const char *cxx = std::getenv("QUANTSCRIPT_CXX");
+        return std::string(cxx ? cxx : "c++") + " -O2 -std=c++17 -shared -fPIC";
+    };
+
+#ifdef _WIN32
+    std::shared_ptr<const NativeModule> NativeModule::load(const std::string &source, const std::string &cacheDir,
+                                                           const std::string &command)
+    {
+        throw native_build_error("Native modules are not supported on this platform");
+    };
+#else
+    namespace
+    {
+        namespace fs = std::filesystem;
+
+        // Compile source into qs_<key>.so in dir, under private names renamed at the end as concurrent
+        // processes may race on the same script
+        void build(const std::string &source, const std::string &command, const fs::path &dir, const std::string &key)
+        {
+            fs::create_directories(dir);
+            const std::string pid = std::to_string(getpid());
+            const fs::path src = dir / ("qs_" + key + "." + pid + ".cpp");
+            {
+                std::ofstream out(src);
+                out << source;
+                if (!out)
+                    throw std::runtime_error("Cannot write " + src.string());
+            }
+            const fs::path tmp = dir / ("qs_" + key + ".so." + pid);
+            const std::string cmd = command + " -o \"" + tmp.string() + "\" \"" + src.string() + "\"";
+            const bool built = std::system(cmd.c_str()) == 0;
+            // The source is kept next to the library for inspection
+            fs::rename(src, dir / ("qs_" + key + ".cpp"));
+            if (!built)
+            {
+                fs::remove(tmp);
+                throw native_build_error("Compilation failed: " + cmd);
+            }
+            fs::rename(tmp, dir / ("qs_" + key + ".so"));
+        };
+    }
+
+    std::shared_ptr<const NativeModule> NativeModule::load(const std::string &source, const std::string &cacheDir,
+                                                           const std::string &command)
+    {
+        const std::string key = toHex(fnv1a(command, fnv1a(source)));
+        const fs::path dir(cacheDir);
+        const fs::path lib = dir / ("qs_" + key + ".so");
+
+        if (!fs::exists(lib))
+            build(source, command, dir, key);
+
+        using CountFn = unsigned (*)();
+        for (bool rebuilt = false;; rebuilt = true)
+        {
+            void *handle = dlopen(lib.c_str(), RTLD_NOW | RTLD_LOCAL);
+            if (!handle)
+                throw std::runtime_error(std::string("Cannot load ") + lib.string() + ": " + dlerror());
+            std::shared_ptr<NativeModule> module(new NativeModule());
+            module->myHandle = std::shared_ptr<void>(handle, [](void *h) { dlclose(h); });
+            module->myPath = lib.string();
+
+            auto version = reinterpret_cast<CountFn>(dlsym(handle, "qs_abi_version"));
+            auto numVariables = reinterpret_cast<CountFn>(dlsym(handle, "qs_num_variables"));
+            auto numEvents = reinterpret_cast<CountFn>(dlsym(handle, "qs_num_events"));
+            module->myEvaluate = reinterpret_cast<EvaluateFn>(dlsym(handle, "qs_evaluate_double"));
+            if (!version || !numVariables || !numEvents || !module->myEvaluate)
+                throw std::runtime_error("Missing entry points in " + lib.string());
+            if (version() == CODEGEN_ABI_VERSION)
+            {
+                module->myNumVariables = numVariables();
+                module->myNumEvents = numEvents();
+                return module;
+            }
+            if (rebuilt)
+                throw std::runtime_error("ABI version mismatch in " + lib.string() + " after a rebuild");
+            // Built by another version of the code generator, replace it
+            module.reset();
+            fs::remove(lib);
+            build(source, command, dir, key);
+        }
+    };
+#endif
+}
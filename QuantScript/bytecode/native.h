@@ -0,0 +1,82 @@
+#pragma once
+#include "models/models.h"
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace QuantScript
+{
+    // The compiler rejected a generated source, or native modules are not supported on the platform
+    struct native_build_error : public std::runtime_error
+    {
+        native_build_error(const std::string &msg) : std::runtime_error(msg) {}
+    };
+
+    // Shared object built from a generated source (see CodeGenerator). Objects are
+    // cached in a directory under a hash of the source and compiler command, so a
+    // script is only compiled the first time it is seen.
+    class NativeModule
+    {
+    public:
+        using EvaluateFn = void (*)(double *, const double *, const double *);
+
+    private:
+        std::shared_ptr<void> myHandle;
+        EvaluateFn myEvaluate = nullptr;
+        unsigned myNumVariables = 0;
+        unsigned myNumEvents = 0;
+        std::string myPath;
+
+        NativeModule() {};
+
+    public:
+        // Compile command used when none is given, QUANTSCRIPT_CXX overrides the compiler
+        static std::string defaultCommand();
+        // Load the module for source from cacheDir, building it first if absent. A cached object
+        // from another CODEGEN_ABI_VERSION is deleted and built again. Throws native_build_error
+        // when the compiler fails and std::runtime_error when the object cannot be written or loaded
+        static std::shared_ptr<const NativeModule> load(const std::string &source, const std::string &cacheDir,
+                                                        const std::string &command = defaultCommand());
+
+        EvaluateFn function() const { return myEvaluate; };
+        unsigned numVariables() const { return myNumVariables; };
+        unsigned numEvents() const { return myNumEvents; };
+        const std::string &path() const { return myPath; };
+    };
+
+    // Runs a loaded module on double scenarios, one evaluator per thread
+    class NativeEvaluator
+    {
+        std::shared_ptr<const NativeModule> myModule;
+        std::vector<double> myVariables;
+        std::vector<double> mySpots;
+        std::vector<double> myNumeraires;
+
+    public:
+        NativeEvaluator(std::shared_ptr<const NativeModule> module)
+            : myModule(module), myVariables(module->numVariables()),
+              mySpots(module->numEvents()), myNumeraires(module->numEvents()) {};
+
+        // (Re-)initialize before evaluation in each scenario
+        void init()
+        {
+            std::fill(myVariables.begin(), myVariables.end(), 0.0);
+        };
+
+        std::vector<double> varVals() const
+        {
+            return myVariables;
+        };
+
+        void evaluate(const Scenario<double> &scenario)
+        {
+            for (size_t i = 0; i < mySpots.size(); ++i)
+            {
+                mySpots[i] = scenario.spot(i);
+                myNumeraires[i] = scenario.numeraire(i);
+            }
+            myModule->function()(myVariables.data(), mySpots.data(), myNumeraires.data());
+        };
+    };
+}
@@ -4,6 +4,7 @@
 #include "product/product.h"
 #include "parser/parser.h"
 #include "models/models.h"
+#include "product/statistics.h"
 #include <automatic/aad.h>
 #include <vector>
 #include <map>
@@ -45,13 +46,15 @@ void test_macro_replacer()
 }
 template <class T>
 void simpleBsScriptVal(const Date &today, T spot, T vol, T rate, const std::map<Date, std::string> &events,
-					   const unsigned numSim, vector<string> &varNames, vector<T> &varVals)
+					   const unsigned numSim, vector<string> &varNames, vector<T> &varVals, PathStatistics &statistics)
 {
 	if (events.begin()->first < today)
 		throw std::runtime_error("Events in the past are disallowed");
 	// Initialize product
 	Product prd;
 	prd.parseEvents(events.begin(), events.end());
+	prd.foldConstants();
+	prd.eliminateCommonSubexpressions();
 	prd.indexVariables();
 
 	// Build evaluator and scenarios
@@ -65,6 +68,7 @@ void simpleBsScriptVal(const Date &today, T spot, T vol, T rate, const std::map<
 	// Initialize results
 	varNames = prd.varNames();
 	varVals.resize(varNames.size(), 0.0);
+	statistics = PathStatistics(varNames.size());
 	// Loop over simulations
 
 	for (size_t i = 0; i < numSim; ++i)
@@ -76,10 +80,11 @@ void simpleBsScriptVal(const Date &today, T spot, T vol, T rate, const std::map<
 		// Evaluate product
 		prd.evaluate(*scen, *eval);
 		// Update results
-
+		statistics.add(eval->variables());
+		// Averages are also kept in T, the adjoints are taken from them
 		for (size_t v = 0; v < varVals.size(); ++v)
 		{
-			varVals[v] += (eval->varVals()[v]) / numSim;
+			varVals[v] += (eval->variables()[v]) / numSim;
 		}
 	}
 }
@@ -98,10 +103,11 @@ int evaluation_test()
 	// Main call
 	vector<string> varNames;
 	vector<T> varVals;
+	PathStatistics statistics;
 	try
 	{
 		simpleBsScriptVal<T>(today, spot, vol, rate,
-							 events, numSim, varNames, varVals);
+							 events, numSim, varNames, varVals, statistics);
 	}
 	catch (const runtime_error &rte)
 	{
@@ -110,7 +116,7 @@ int evaluation_test()
 	}
 	for (size_t i = 0; i < varNames.size(); ++i)
 	{
-		cout << varNames[i] << " = " << varVals[i] << endl;
+		cout << varNames[i] << " = " << varVals[i] << " +/- " << statistics.standardError(i) << endl;
 	}
 
 	vector<double> sens = calculateAdjoints(varVals[0]);
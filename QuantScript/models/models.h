@@ -1,24 +1,86 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <random>
 #include <memory>
 #include <stdexcept>
 #include <map>
+#include <string>
 #include <ql/time/daycounters/actual360.hpp>
 #include "nodes/nodes.h"
 
 namespace QuantScript
 {
+	// Spots and numeraires of one path, each in its own contiguous array. Models write and
+	// evaluators read through spot(e) and numeraire(e), scenario[e].spot and whole-event
+	// copies scenario[e] = other[f] still work
 	template <class T>
-	struct SimulationData
+	class Scenario
 	{
-		T spot;
-		T numeraire;
+		std::vector<T> mySpots;
+		std::vector<T> myNumeraires;
+
+	public:
+		// Data of one event, by reference
+		struct ConstEventRef
+		{
+			const T &spot;
+			const T &numeraire;
+		};
+		struct EventRef
+		{
+			T &spot;
+			T &numeraire;
+
+			// Whole-event copies, e.g. s[i] = t[j], assign through to the arrays
+			EventRef &operator=(const ConstEventRef &rhs)
+			{
+				spot = rhs.spot;
+				numeraire = rhs.numeraire;
+				return *this;
+			}
+			EventRef &operator=(const EventRef &rhs) { return *this = ConstEventRef{rhs.spot, rhs.numeraire}; }
+		};
+
+		Scenario(size_t numEvents = 0) : mySpots(numEvents), myNumeraires(numEvents) {}
+		size_t size() const { return mySpots.size(); }
+		void resize(size_t numEvents)
+		{
+			mySpots.resize(numEvents);
+			myNumeraires.resize(numEvents);
+		}
+		T &spot(size_t e) { return mySpots[e]; }
+		const T &spot(size_t e) const { return mySpots[e]; }
+		T &numeraire(size_t e) { return myNumeraires[e]; }
+		const T &numeraire(size_t e) const { return myNumeraires[e]; }
+		T *spots() { return mySpots.data(); }
+		const T *spots() const { return mySpots.data(); }
+		T *numeraires() { return myNumeraires.data(); }
+		const T *numeraires() const { return myNumeraires.data(); }
+		EventRef operator[](size_t e) { return {mySpots[e], myNumeraires[e]}; }
+		ConstEventRef operator[](size_t e) const { return {mySpots[e], myNumeraires[e]}; }
 	};
 
-	template <class T>
-	using Scenario = std::vector<SimulationData<T>>;
+	// N scenarios laid out [event][lane] so that each event reads contiguous lanes
+	template <size_t N>
+	struct ScenarioBatch
+	{
+		std::vector<double> spots;
+		std::vector<double> numeraires;
+
+		ScenarioBatch(size_t nEvents) : spots(nEvents * N), numeraires(nEvents * N) {};
+		size_t size() const { return spots.size() / N; }
+		// Copy a scalar scenario into one lane
+		void set(size_t lane, const Scenario<double> &scenario)
+		{
+			for (size_t e = 0; e < scenario.size(); ++e)
+			{
+				spots[e * N + lane] = scenario.spot(e);
+				numeraires[e * N + lane] = scenario.numeraire(e);
+			}
+		}
+	};
 
 	struct randomgen_error : public std::runtime_error
 	{
@@ -88,8 +150,21 @@ namespace QuantScript
 		virtual void initSimDates(const std::vector<Date> &simDates) = 0;
 		// Number of Gaussian numbers required for one path
 		virtual size_t dim() const = 0;
-		// Apply the model SDE
-		virtual void applySDE(const std::vector<double> &G, std::vector<T> &spots, std::vector<T> &numeraire) const = 0;
+		// Path-independent quantities of the parameters and simulation dates, e.g. numeraires
+		// and drifts. Called at the end of initSimDates, call again after changing parameters.
+		// With AAD it runs after the parameters are put on tape, so each is recorded once
+		// before the mark rather than on every path
+		virtual void precompute() = 0;
+		// Apply the model SDE, writing the spot and numeraire of every simulation date
+		// straight into the scenario, which has one entry per date
+		virtual void applySDE(const std::vector<double> &G, Scenario<T> &scenario) const = 0;
+		// Apply the SDE to numPaths paths at once. G holds the Gaussians of every path laid out
+		// [step][path] and spots and numeraires are written [event][path], so that models step
+		// all paths with contiguous loops
+		virtual void applySDEBatch(const double *G, const size_t numPaths, T *spots, T *numeraires) const = 0;
+		// Parameters risk is computed to, pointing into this model
+		virtual std::vector<T *> parameters() = 0;
+		virtual std::vector<std::string> parameterLabels() const = 0;
 	};
 
 	template <class T>
@@ -99,24 +174,18 @@ namespace QuantScript
 		T mySpot;
 		T myVol;
 		T myRate;
-		T myDrift;
 		bool myTime0; // If today is among simul dates
 		std::vector<double> myTimes;
 		std::vector<double> myDt;
 		std::vector<double> mySqrtDt;
-
-	private:
-		void calcDf(std::vector<T> &dfs) const
-		{
-			for (size_t i = 0; i < myTimes.size(); ++i)
-				// Despite the name of the variable, this is not the discount factor
-				// but its inverse, hence, the numeraire
-				dfs[i] = exp(myRate * myTimes[i]);
-		}
+		// Precomputed: numeraire, (rate - vol^2 / 2) * dt and vol * sqrt(dt) per date
+		std::vector<T> myNumeraires;
+		std::vector<T> myDriftDt;
+		std::vector<T> myVolSqrtDt;
 
 	public:
 		// Construct with T0, S0, vol and rate
-		SimpleBlackScholes(const Date &today, T spot, T vol, T rate) : myToday(today), mySpot(spot), myVol(vol), myRate(rate), myDrift(0.5 * vol * vol) {}
+		SimpleBlackScholes(const Date &today, T spot, T vol, T rate) : myToday(today), mySpot(spot), myVol(vol), myRate(rate) {}
 		// clone
 		virtual std::unique_ptr<Model<T>> clone() const override
 		{
@@ -126,18 +195,21 @@ namespace QuantScript
 		const T &spot() { return mySpot; }
 		const T &rate() { return myRate; }
 		const T &vol() { return myVol; }
+		std::vector<T *> parameters() override { return {&mySpot, &myVol, &myRate}; }
+		std::vector<std::string> parameterLabels() const override { return {"spot", "vol", "rate"}; }
 		// Initialize simulation dates
-                void initSimDates(const std::vector<Date> &simDates) override
-                {
-                        myTime0 = simDates[0] == myToday;
-                        QuantLib::Actual360 dc;
-                        // Fill array of times using QuantLib day count
-                        for (auto dateIt = simDates.begin();
-                             dateIt != simDates.end();
-                             ++dateIt)
-                        {
-                                myTimes.push_back(dc.yearFraction(myToday, *dateIt));
-                        }
+		void initSimDates(const std::vector<Date> &simDates) override
+		{
+			myTime0 = simDates[0] == myToday;
+			myTimes.clear();
+			QuantLib::Actual360 dc;
+			// Fill array of times using QuantLib day count
+			for (auto dateIt = simDates.begin();
+				 dateIt != simDates.end();
+				 ++dateIt)
+			{
+				myTimes.push_back(dc.yearFraction(myToday, *dateIt));
+			}
 			myDt.resize(myTimes.size());
 			myDt[0] = myTimes[0];
 			for (size_t i = 1; i < myTimes.size(); ++i)
@@ -149,20 +221,64 @@ namespace QuantScript
 			{
 				mySqrtDt[i] = sqrt(myDt[i]);
 			}
+			precompute();
+		}
+		void precompute() override
+		{
+			const T drift = myRate - 0.5 * myVol * myVol;
+			myNumeraires.resize(myTimes.size());
+			myDriftDt.resize(myTimes.size());
+			myVolSqrtDt.resize(myTimes.size());
+			for (size_t i = 0; i < myTimes.size(); ++i)
+			{
+				myNumeraires[i] = exp(myRate * myTimes[i]);
+				myDriftDt[i] = drift * myDt[i];
+				myVolSqrtDt[i] = myVol * mySqrtDt[i];
+			}
 		}
 		size_t dim() const override { return myTimes.size() - myTime0; }
 		// Simulate one path
-		void applySDE(const std::vector<double> &G, std::vector<T> &spots, std::vector<T> &numeraires) const override
+		void applySDE(const std::vector<double> &G, Scenario<T> &scenario) const override
 		{
-			calcDf(numeraires);
 			// Apply the SDE
 			size_t step = 0;
 			// First step
-			spots[0] = myTime0 ? mySpot : mySpot * exp((myRate - myDrift) * myDt[0] + myVol * mySqrtDt[0] * G[step++]);
+			scenario.spot(0) = myTime0 ? mySpot : mySpot * exp(myDriftDt[0] + myVolSqrtDt[0] * G[step++]);
+			scenario.numeraire(0) = myNumeraires[0];
 			// All steps
 			for (size_t i = 1; i < myTimes.size(); ++i)
 			{
-				spots[i] = spots[i - 1] * exp((myRate - myDrift) * myDt[i] + myVol * mySqrtDt[i] * G[step++]);
+				scenario.spot(i) = scenario.spot(i - 1) * exp(myDriftDt[i] + myVolSqrtDt[i] * G[step++]);
+				scenario.numeraire(i) = myNumeraires[i];
+			}
+		}
+		// Simulate numPaths paths, one event of every path at a time
+		void applySDEBatch(const double *G, const size_t numPaths, T *spots, T *numeraires) const override
+		{
+			size_t step = 0;
+			// First step
+			if (myTime0)
+			{
+				std::fill(spots, spots + numPaths, mySpot);
+			}
+			else
+			{
+				for (size_t p = 0; p < numPaths; ++p)
+					spots[p] = mySpot * exp(myDriftDt[0] + myVolSqrtDt[0] * G[p]);
+				++step;
+			}
+			std::fill(numeraires, numeraires + numPaths, myNumeraires[0]);
+			// All steps
+			for (size_t i = 1; i < myTimes.size(); ++i, ++step)
+			{
+				const T driftDt = myDriftDt[i];
+				const T volSqrtDt = myVolSqrtDt[i];
+				const double *g = G + step * numPaths;
+				const T *previous = spots + (i - 1) * numPaths;
+				T *current = spots + i * numPaths;
+				for (size_t p = 0; p < numPaths; ++p)
+					current[p] = previous[p] * exp(driftDt + volSqrtDt * g[p]);
+				std::fill(numeraires + i * numPaths, numeraires + (i + 1) * numPaths, myNumeraires[i]);
 			}
 		}
 	};
@@ -172,6 +288,8 @@ namespace QuantScript
 	{
 		RandomGen &myRandomGen;
 		Model<T> &myModel;
+		// Gaussians of a batch of paths, [step][path]
+		std::vector<double> myGaussians;
 
 	public:
 		MonteCarloSimulator(Model<T> &model, RandomGen &ranGen) : myRandomGen(ranGen), myModel(model) {}
@@ -180,10 +298,25 @@ namespace QuantScript
 			myModel.initSimDates(simDates);
 			myRandomGen.init(myModel.dim());
 		}
-		void simulateOnePath(std::vector<T> &spots, std::vector<T> &numeraire)
+		void simulateOnePath(Scenario<T> &scenario)
 		{
 			myRandomGen.genNextNormVec();
-			myModel.applySDE(myRandomGen.getNorm(), spots, numeraire);
+			myModel.applySDE(myRandomGen.getNorm(), scenario);
+		}
+		// Simulate numPaths paths into spots and numeraires laid out [event][path],
+		// drawing the Gaussians of each path in turn as simulateOnePath does
+		void simulatePaths(const size_t numPaths, T *spots, T *numeraires)
+		{
+			const size_t dim = myModel.dim();
+			myGaussians.resize(dim * numPaths);
+			for (size_t p = 0; p < numPaths; ++p)
+			{
+				myRandomGen.genNextNormVec();
+				const std::vector<double> &G = myRandomGen.getNorm();
+				for (size_t k = 0; k < dim; ++k)
+					myGaussians[k * numPaths + p] = G[k];
+			}
+			myModel.applySDEBatch(myGaussians.data(), numPaths, spots, numeraires);
 		}
 	};
 
@@ -197,26 +330,22 @@ namespace QuantScript
 	template <class T>
 	class ScriptSimulator : public MonteCarloSimulator<T>, public ScriptModelApi<T>
 	{
-		std::vector<T> myTempSpots;
-		std::vector<T> myTempNumeraires;
-
 	public:
 		ScriptSimulator(Model<T> &model, RandomGen &ranGen) : MonteCarloSimulator<T>(model, ranGen) {}
 		void initForScripting(const std::vector<Date> &eventDates) override
 		{
 			MonteCarloSimulator<T>::init(eventDates);
-			myTempSpots.resize(eventDates.size());
-			myTempNumeraires.resize(eventDates.size());
 		}
+		// The model writes into s, sized to the event dates
 		void nextScenario(Scenario<T> &s) override
 		{
-			MonteCarloSimulator<T>::simulateOnePath(myTempSpots, myTempNumeraires);
-			// Note the inefficiency
-			for (size_t i = 0; i < s.size(); ++i)
-			{
-				s[i].spot = myTempSpots[i];
-				s[i].numeraire = myTempNumeraires[i];
-			}
+			MonteCarloSimulator<T>::simulateOnePath(s);
+		}
+		// Next N paths, the same as N calls to nextScenario
+		template <size_t N>
+		void nextBatch(ScenarioBatch<N> &batch)
+		{
+			MonteCarloSimulator<T>::simulatePaths(N, batch.spots.data(), batch.numeraires.data());
 		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "models/models.h"
+#include "others/gaussians.h"
+
+namespace QuantScript
+{
+	// L'Ecuyer's MRG32k3a, Gaussians by inverse cdf. skipAhead jumps over whole
+	// Gaussian vectors in logarithmic time, so that parallel batches reproduce
+	// exactly the numbers of a sequential run
+	class Mrg32k3aGen : public RandomGen
+	{
+		using Matrix = uint64_t[3][3];
+
+		static constexpr uint64_t m1 = 4294967087;
+		static constexpr uint64_t m2 = 4294944443;
+		static constexpr uint64_t a12 = 1403580;
+		static constexpr uint64_t a13 = 810728;
+		static constexpr uint64_t a21 = 527612;
+		static constexpr uint64_t a23 = 1370589;
+		// Dividing by m1 + 1 keeps uniforms strictly inside (0, 1)
+		static constexpr double m1p1 = 4294967088.0;
+
+		// Last three states of each component, most recent first
+		uint64_t myX[3];
+		uint64_t myY[3];
+		size_t myDim = 0;
+		std::vector<double> myNormVec;
+
+		double nextUniform()
+		{
+			// Products stay below 2^53, reduce the signed combination
+			const int64_t px = (int64_t(a12 * myX[1]) - int64_t(a13 * myX[2])) % int64_t(m1);
+			const uint64_t x = px < 0 ? uint64_t(px + int64_t(m1)) : uint64_t(px);
+			myX[2] = myX[1];
+			myX[1] = myX[0];
+			myX[0] = x;
+			const int64_t py = (int64_t(a21 * myY[0]) - int64_t(a23 * myY[2])) % int64_t(m2);
+			const uint64_t y = py < 0 ? uint64_t(py + int64_t(m2)) : uint64_t(py);
+			myY[2] = myY[1];
+			myY[1] = myY[0];
+			myY[0] = y;
+			return x > y ? double(x - y) / m1p1 : (double(x) - double(y) + double(m1)) / m1p1;
+		}
+
+		// result = lhs * rhs mod m, result may alias lhs or rhs
+		static void matMul(const Matrix &lhs, const Matrix &rhs, const uint64_t m, Matrix &result)
+		{
+			Matrix temp;
+			for (size_t i = 0; i < 3; ++i)
+				for (size_t j = 0; j < 3; ++j)
+				{
+					uint64_t s = 0;
+					// Entries are below 2^32, reduce each product before summing
+					for (size_t k = 0; k < 3; ++k)
+						s = (s + lhs[i][k] * rhs[k][j] % m) % m;
+					temp[i][j] = s;
+				}
+			for (size_t i = 0; i < 3; ++i)
+				for (size_t j = 0; j < 3; ++j)
+					result[i][j] = temp[i][j];
+		}
+
+		// state = A^n state mod m
+		static void jump(const Matrix &a, uint64_t n, const uint64_t m, uint64_t state[3])
+		{
+			Matrix power = {{a[0][0], a[0][1], a[0][2]}, {a[1][0], a[1][1], a[1][2]}, {a[2][0], a[2][1], a[2][2]}};
+			Matrix acc = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+			for (; n > 0; n >>= 1)
+			{
+				if (n & 1)
+					matMul(power, acc, m, acc);
+				matMul(power, power, m, power);
+			}
+			uint64_t next[3];
+			for (size_t i = 0; i < 3; ++i)
+				next[i] = (acc[i][0] * state[0] % m + acc[i][1] * state[1] % m + acc[i][2] * state[2] % m) % m;
+			for (size_t i = 0; i < 3; ++i)
+				state[i] = next[i];
+		}
+
+	public:
+		Mrg32k3aGen(const unsigned seed1 = 12345, const unsigned seed2 = 12346)
+			: myX{seed1, seed1, seed1}, myY{seed2, seed2, seed2} {}
+		void init(const size_t dim) override
+		{
+			myDim = dim;
+			myNormVec.resize(dim);
+		}
+		void genNextNormVec() override
+		{
+			for (size_t i = 0; i < myDim; ++i)
+			{
+				myNormVec[i] = invNormalCdf(nextUniform());
+			}
+		}
+		const std::vector<double> &getNorm() const override
+		{
+			return myNormVec;
+		}
+		std::unique_ptr<RandomGen> clone() const override
+		{
+			return std::unique_ptr<RandomGen>(new Mrg32k3aGen(*this));
+		}
+		// Skip the next skip Gaussian vectors, init must have been called
+		void skipAhead(const long skip) override
+		{
+			if (skip <= 0)
+				return;
+			static constexpr Matrix A1 = {{0, a12, m1 - a13}, {1, 0, 0}, {0, 1, 0}};
+			static constexpr Matrix A2 = {{a21, 0, m2 - a23}, {1, 0, 0}, {0, 1, 0}};
+			const uint64_t numbers = uint64_t(skip) * myDim;
+			jump(A1, numbers, m1, myX);
+			jump(A2, numbers, m2, myY);
+		}
+	};
+}
@@ -0,0 +1,193 @@
+#include "models/pathstore.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace QuantScript
+{
+    namespace
+    {
+        // Layout: header, int32 date serials padded to 8 bytes, spots, numeraires
+        constexpr char STORE_MAGIC[4] = {'Q', 'S', 'P', 'S'};
+        constexpr uint32_t ENDIAN_TAG = 0x01020304u;
+        // Paths simulated between two writes
+        constexpr size_t WRITE_CHUNK = 4096;
+
+        struct StoreHeader
+        {
+            char magic[4];
+            uint32_t version;
+            uint32_t endianTag;
+            uint32_t reserved;
+            uint64_t numEvents;
+            uint64_t numPaths;
+        };
+
+        size_t datesBytes(size_t numEvents)
+        {
+            return (numEvents * sizeof(int32_t) + 7) & ~size_t(7);
+        };
+
+        // Bytes of the spots and numeraires, the largest size_t when they do not fit in one
+        size_t pathBytes(size_t numPaths, size_t numEvents)
+        {
+            constexpr size_t limit = std::numeric_limits<size_t>::max();
+            if (numEvents > limit / (2 * sizeof(double)))
+                return limit;
+            const size_t perPath = 2 * sizeof(double) * numEvents;
+            if (numPaths > 0 && perPath > limit / numPaths)
+                return limit;
+            return numPaths * perPath;
+        };
+
+        // Bytes of the paths to simulate, throws if the timeline is empty or unsorted or they do not fit
+        size_t checkedPathBytes(const std::vector<Date> &timeline, const size_t numPaths)
+        {
+            if (timeline.empty())
+                throw std::runtime_error("Cannot store paths on an empty timeline");
+            if (!std::is_sorted(timeline.begin(), timeline.end()))
+                throw std::runtime_error("Cannot store paths on an unsorted timeline");
+            const size_t bytes = pathBytes(numPaths, timeline.size());
+            if (bytes == std::numeric_limits<size_t>::max())
+                throw std::runtime_error("Too many paths to store: " + std::to_string(numPaths) + " on " +
+                                         std::to_string(timeline.size()) + " dates");
+            return bytes;
+        };
+
+        // Simulate numPaths paths on timeline and hand them to sink(index, path) in order
+        template <class Sink>
+        void simulate(const Model<double> &model, const RandomGen &random, const std::vector<Date> &timeline,
+                      const size_t numPaths, Sink sink)
+        {
+            auto mdl = model.clone();
+            auto rng = random.clone();
+            MonteCarloSimulator<double> simulator(*mdl, *rng);
+            simulator.init(timeline);
+            Scenario<double> path(timeline.size());
+            for (size_t p = 0; p < numPaths; ++p)
+            {
+                simulator.simulateOnePath(path);
+                sink(p, path);
+            }
+        };
+    }
+
+    PathStore::PathStore(const Model<double> &model, const RandomGen &random, const std::vector<Date> &timeline, const size_t numPaths)
+        : myTimeline(timeline), myNumPaths(numPaths), myMemory(checkedPathBytes(timeline, numPaths) / sizeof(double))
+    {
+        const size_t nE = timeline.size();
+        double *spots = myMemory.data();
+        double *numeraires = spots + numPaths * nE;
+        simulate(model, random, timeline, numPaths,
+                 [&](size_t p, const Scenario<double> &path)
+                 {
+                     for (size_t e = 0; e < nE; ++e)
+                     {
+                         spots[p * nE + e] = path.spot(e);
+                         numeraires[p * nE + e] = path.numeraire(e);
+                     }
+                 });
+        mySpots = spots;
+        myNumeraires = numeraires;
+    };
+
+    void PathStore::write(const std::string &path, const Model<double> &model, const RandomGen &random,
+                          const std::vector<Date> &timeline, const size_t numPaths)
+    {
+        const size_t nE = timeline.size();
+        checkedPathBytes(timeline, numPaths);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+            throw std::runtime_error("Cannot write " + path);
+
+        StoreHeader header = {};
+        std::memcpy(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+        header.version = PATH_STORE_VERSION;
+        header.endianTag = ENDIAN_TAG;
+        header.numEvents = nE;
+        header.numPaths = numPaths;
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        std::vector<int32_t> serials(datesBytes(nE) / sizeof(int32_t), 0);
+        for (size_t e = 0; e < nE; ++e)
+            serials[e] = static_cast<int32_t>(timeline[e].serialNumber());
+        out.write(reinterpret_cast<const char *>(serials.data()), datesBytes(nE));
+
+        // Spots and numeraires of a chunk go to their own block
+        const std::streamoff spotsBase = sizeof(StoreHeader) + datesBytes(nE);
+        const std::streamoff numerairesBase = spotsBase + std::streamoff(numPaths * nE * sizeof(double));
+        std::vector<double> spots, numeraires;
+        size_t first = 0;
+        auto flush = [&]()
+        {
+            const std::streamoff offset = std::streamoff(first * nE * sizeof(double));
+            out.seekp(spotsBase + offset);
+            out.write(reinterpret_cast<const char *>(spots.data()), std::streamsize(spots.size() * sizeof(double)));
+            out.seekp(numerairesBase + offset);
+            out.write(reinterpret_cast<const char *>(numeraires.data()), std::streamsize(numeraires.size() * sizeof(double)));
+            spots.clear();
+            numeraires.clear();
+        };
+        simulate(model, random, timeline, numPaths,
+                 [&](size_t p, const Scenario<double> &path)
+                 {
+                     spots.insert(spots.end(), path.spots(), path.spots() + nE);
+                     numeraires.insert(numeraires.end(), path.numeraires(), path.numeraires() + nE);
+                     if (p + 1 - first == WRITE_CHUNK)
+                     {
+                         flush();
+                         first = p + 1;
+                     }
+                 });
+        flush();
+        if (!out)
+            throw std::runtime_error("Cannot write " + path);
+    };
+
+    PathStore::PathStore(const std::string &path) : myFile(std::make_unique<MappedFile>(path))
+    {
+        const char *data = myFile->data();
+        const size_t size = myFile->size();
+        StoreHeader header;
+        if (size < sizeof(header))
+            throw std::runtime_error(path + " is not a path store");
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0)
+            throw std::runtime_error(path + " is not a path store");
+        if (header.endianTag != ENDIAN_TAG)
+            throw std::runtime_error(path + " was written with a different endianness");
+        if (header.version != PATH_STORE_VERSION)
+            throw std::runtime_error(path + " has path store version " + std::to_string(header.version) +
+                                     ", expected " + std::to_string(PATH_STORE_VERSION));
+        const size_t nE = header.numEvents;
+        myNumPaths = header.numPaths;
+        // Sizes bounded by the file first, so that a corrupt header cannot overflow them
+        const size_t available = size - sizeof(header);
+        if (nE == 0 || nE > available / sizeof(int32_t) || datesBytes(nE) > available ||
+            available - datesBytes(nE) != pathBytes(myNumPaths, nE))
+            throw std::runtime_error(path + " is truncated or corrupt");
+
+        const int32_t *serials = reinterpret_cast<const int32_t *>(data + sizeof(header));
+        for (size_t e = 0; e < nE; ++e)
+            myTimeline.push_back(Date(static_cast<Date::serial_type>(serials[e])));
+        if (!std::is_sorted(myTimeline.begin(), myTimeline.end()))
+            throw std::runtime_error(path + " is truncated or corrupt");
+        mySpots = reinterpret_cast<const double *>(data + sizeof(header) + datesBytes(nE));
+        myNumeraires = mySpots + myNumPaths * nE;
+    };
+
+    std::vector<size_t> PathStore::indicesOf(const std::vector<Date> &dates) const
+    {
+        std::vector<size_t> indices;
+        indices.reserve(dates.size());
+        for (const Date &d : dates)
+        {
+            const auto it = std::lower_bound(myTimeline.begin(), myTimeline.end(), d);
+            if (it == myTimeline.end() || *it != d)
+                throw std::runtime_error("Event date not on the timeline of the path store");
+            indices.push_back(it - myTimeline.begin());
+        }
+        return indices;
+    };
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "models/models.h"
+#include "others/mappedfile.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace QuantScript
+{
+    // Bumped whenever the layout of the file changes
+    constexpr uint32_t PATH_STORE_VERSION = 1;
+
+    // Spots and numeraires of numPaths paths of a model on a timeline, simulated once and
+    // read back by every later valuation or solver iteration. Structure of arrays: all the
+    // spots, then all the numeraires, each path contiguous over the timeline. Paths are held
+    // in memory, or written to a file and mapped for path counts that do not fit in memory.
+    // Files are only portable between builds with the same endianness
+    class PathStore
+    {
+        std::vector<Date> myTimeline;
+        size_t myNumPaths = 0;
+        std::vector<double> myMemory;
+        std::unique_ptr<const MappedFile> myFile;
+        const double *mySpots = nullptr;
+        const double *myNumeraires = nullptr;
+
+    public:
+        // Simulate in memory, throws std::runtime_error if the timeline is empty or unsorted
+        // or the paths do not fit in memory
+        PathStore(const Model<double> &model, const RandomGen &random, const std::vector<Date> &timeline, const size_t numPaths);
+        // Map a file written by write, throws std::runtime_error on a bad or foreign file
+        explicit PathStore(const std::string &path);
+        PathStore(const PathStore &) = delete;
+        PathStore &operator=(const PathStore &) = delete;
+
+        // Simulate into path a chunk of paths at a time, throws std::runtime_error if the file cannot be
+        // written, or on the timelines and path counts the in-memory constructor rejects
+        static void write(const std::string &path, const Model<double> &model, const RandomGen &random,
+                          const std::vector<Date> &timeline, const size_t numPaths);
+
+        size_t numPaths() const { return myNumPaths; };
+        size_t numEvents() const { return myTimeline.size(); };
+        const std::vector<Date> &timeline() const { return myTimeline; };
+        const double *spots(size_t path) const { return mySpots + path * myTimeline.size(); };
+        const double *numeraires(size_t path) const { return myNumeraires + path * myTimeline.size(); };
+
+        // Timeline index of each date, throws std::runtime_error if one is not on the timeline
+        std::vector<size_t> indicesOf(const std::vector<Date> &dates) const;
+        // Scenario of a product on the dates at the given timeline indices
+        template <class T>
+        void load(size_t path, const std::vector<size_t> &indices, Scenario<T> &scenario) const
+        {
+            const double *s = spots(path);
+            const double *n = numeraires(path);
+            for (size_t e = 0; e < indices.size(); ++e)
+            {
+                scenario.spot(e) = T(s[indices[e]]);
+                scenario.numeraire(e) = T(n[indices[e]]);
+            }
+        };
+    };
+
+    // Replays the paths of a PathStore in order, in place of a ScriptSimulator.
+    // Event dates must be on the timeline of the store
+    class StoredPathSimulator : public ScriptModelApi<double>
+    {
+        const PathStore &myStore;
+        std::vector<size_t> myIndices;
+        size_t myNext = 0;
+
+    public:
+        StoredPathSimulator(const PathStore &store) : myStore(store) {};
+        void initForScripting(const std::vector<Date> &eventDates) override
+        {
+            myIndices = myStore.indicesOf(eventDates);
+            myNext = 0;
+        };
+        void nextScenario(Scenario<double> &s) override
+        {
+            if (myNext == myStore.numPaths())
+                throw std::runtime_error("Path store exhausted");
+            myStore.load(myNext++, myIndices, s);
+        };
+        // Next path replayed
+        void setPosition(size_t path) { myNext = path; };
+    };
+}
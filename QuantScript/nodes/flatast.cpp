@@ -0,0 +1,120 @@
+#include "nodes/flatast.h"
+#include "visitors/visitor.h"
+#include "parser/parser.h"
+
+namespace QuantScript
+{
+    // Kind and payload of a pointer-tree node
+    class KindTagger : public ConstVisitor
+    {
+    public:
+        NodeKind kind;
+        double value = 0.0;
+        uint32_t index = 0;
+        int firstElse = -1;
+
+        void visitUplus(const NodeUplus &node) override { kind = NodeKind::Uplus; };
+        void visitUminus(const NodeUminus &node) override { kind = NodeKind::Uminus; };
+        void visitAdd(const NodeAdd &node) override { kind = NodeKind::Add; };
+        void visitSubtract(const NodeSubtract &node) override { kind = NodeKind::Subtract; };
+        void visitMult(const NodeMult &node) override { kind = NodeKind::Mult; };
+        void visitDiv(const NodeDiv &node) override { kind = NodeKind::Div; };
+        void visitPow(const NodePow &node) override { kind = NodeKind::Pow; };
+        void visitLog(const NodeLog &node) override { kind = NodeKind::Log; };
+        void visitSqrt(const NodeSqrt &node) override { kind = NodeKind::Sqrt; };
+        void visitMax(const NodeMax &node) override { kind = NodeKind::Max; };
+        void visitMin(const NodeMin &node) override { kind = NodeKind::Min; };
+        void visitAssign(const NodeAssign &node) override { kind = NodeKind::Assign; };
+        void visitEqual(const NodeEqual &node) override { kind = NodeKind::Equal; };
+        void visitDifferent(const NodeDifferent &node) override { kind = NodeKind::Different; };
+        void visitSuperior(const NodeSuperior &node) override { kind = NodeKind::Superior; };
+        void visitSupEqual(const NodeSupEqual &node) override { kind = NodeKind::SupEqual; };
+        void visitInferior(const NodeInferior &node) override { kind = NodeKind::Inferior; };
+        void visitInfEqual(const NodeInfEqual &node) override { kind = NodeKind::InfEqual; };
+        void visitAnd(const NodeAnd &node) override { kind = NodeKind::And; };
+        void visitOr(const NodeOr &node) override { kind = NodeKind::Or; };
+        void visitIf(const NodeIf &node) override
+        {
+            kind = NodeKind::If;
+            firstElse = node.firstElse;
+        };
+        void visitSpot(const NodeSpot &node) override { kind = NodeKind::Spot; };
+        void visitConst(const NodeConst &node) override
+        {
+            kind = NodeKind::Const;
+            value = node.value;
+        };
+        void visitVar(const NodeVar &node) override
+        {
+            kind = NodeKind::Var;
+            index = node.index;
+        };
+        void visitPays(const NodePays &node) override { kind = NodeKind::Pays; };
+        void visitSolver(const NodeSolver &node) override { kind = NodeKind::Solver; };
+        void visitDefinition(const NodeDefinition &node) override
+        {
+            throw script_error("Definitions are not supported by the flat AST");
+        };
+    };
+
+    uint32_t FlatAst::allocate(size_t n)
+    {
+        const uint32_t first = static_cast<uint32_t>(myNodeStore.size());
+        myNodeStore.resize(myNodeStore.size() + n);
+        return first;
+    };
+
+    void FlatAst::fill(uint32_t index, const Node &node)
+    {
+        KindTagger tagger;
+        node.acceptVisitor(tagger);
+        // Children block first, then each child's own subtree
+        const uint32_t count = static_cast<uint32_t>(node.arguments.size());
+        const uint32_t first = allocate(count);
+        uint32_t data = 0;
+        switch (tagger.kind)
+        {
+        case NodeKind::Const:
+            data = static_cast<uint32_t>(myConstantStore.size());
+            myConstantStore.push_back(tagger.value);
+            break;
+        case NodeKind::Var:
+            data = tagger.index;
+            break;
+        case NodeKind::If:
+            data = tagger.firstElse == -1 ? NO_ELSE : static_cast<uint32_t>(tagger.firstElse);
+            break;
+        case NodeKind::Solver:
+            data = myNumSolvers++;
+            break;
+        default:
+            break;
+        }
+        // myNodeStore may reallocate while filling children, index rather than hold a reference
+        myNodeStore[index] = {tagger.kind, first, count, data};
+        for (uint32_t i = 0; i < count; ++i)
+            fill(first + i, *node.arguments[i]);
+    };
+
+    FlatAst::FlatAst(const std::vector<Event> &events, const std::vector<std::string> &varNames)
+        : myVarNames(varNames)
+    {
+        for (auto &e : events)
+        {
+            const uint32_t first = allocate(e.size());
+            myEventStore.push_back({first, static_cast<uint32_t>(e.size())});
+            for (size_t i = 0; i < e.size(); ++i)
+                fill(first + static_cast<uint32_t>(i), *e[i]);
+        }
+        myNodeStore.shrink_to_fit();
+        myConstantStore.shrink_to_fit();
+        myNodes = myNodeStore;
+        myConstants = myConstantStore;
+        myEvents = myEventStore;
+    };
+
+    FlatAst::FlatAst(std::span<const FlatNode> nodes, std::span<const double> constants, std::span<const EventRange> events,
+                     std::vector<std::string> varNames, uint32_t numSolvers, std::shared_ptr<const void> backing)
+        : myNodes(nodes), myConstants(constants), myEvents(events), myVarNames(std::move(varNames)),
+          myNumSolvers(numSolvers), myBacking(std::move(backing)) {};
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "nodes/nodes.h"
+
+namespace QuantScript
+{
+    enum class NodeKind : uint8_t
+    {
+        Uplus,
+        Uminus,
+        Add,
+        Subtract,
+        Mult,
+        Div,
+        Pow,
+        Log,
+        Sqrt,
+        Max,
+        Min,
+        Assign,
+        Equal,
+        Different,
+        Superior,
+        SupEqual,
+        Inferior,
+        InfEqual,
+        And,
+        Or,
+        If,
+        Spot,
+        Const,
+        Var,
+        Pays,
+        Solver
+    };
+
+    // Node of a FlatAst, 16 bytes. Children are contiguous, starting at first.
+    // data holds the variable index (Var), constant index (Const), solver slot
+    // (Solver) or the child position of the first else statement (If, NO_ELSE if none)
+    struct FlatNode
+    {
+        NodeKind kind;
+        uint32_t first;
+        uint32_t count;
+        uint32_t data;
+    };
+
+    // Events of a product stored in one contiguous node buffer with 32-bit links.
+    // Statements of an event are contiguous and followed by their subtrees, each
+    // node's children are laid out together so a walk moves forward through memory.
+    // The buffers are either owned or viewed in external memory, e.g. a mapped ProductArchive.
+    class FlatAst
+    {
+    public:
+        static constexpr uint32_t NO_ELSE = 0xffffffffu;
+        struct EventRange
+        {
+            uint32_t first;
+            uint32_t count;
+        };
+
+    private:
+        std::vector<FlatNode> myNodeStore;
+        std::vector<double> myConstantStore;
+        std::vector<EventRange> myEventStore;
+        std::span<const FlatNode> myNodes;
+        std::span<const double> myConstants;
+        std::span<const EventRange> myEvents;
+        std::vector<std::string> myVarNames;
+        uint32_t myNumSolvers = 0;
+        // Keeps external buffers alive
+        std::shared_ptr<const void> myBacking;
+
+        uint32_t allocate(size_t n);
+        void fill(uint32_t index, const Node &node);
+
+    public:
+        FlatAst() {};
+        // Events must have been indexed, varNames as returned by Product::varNames
+        FlatAst(const std::vector<Event> &events, const std::vector<std::string> &varNames);
+        // View of buffers owned by backing, nothing is copied
+        FlatAst(std::span<const FlatNode> nodes, std::span<const double> constants, std::span<const EventRange> events,
+                std::vector<std::string> varNames, uint32_t numSolvers, std::shared_ptr<const void> backing);
+        // Views would point into the source
+        FlatAst(const FlatAst &) = delete;
+        FlatAst &operator=(const FlatAst &) = delete;
+
+        const FlatNode &node(uint32_t i) const { return myNodes[i]; };
+        std::span<const FlatNode> nodes() const { return myNodes; };
+        double constant(uint32_t i) const { return myConstants[i]; };
+        std::span<const double> constants() const { return myConstants; };
+        std::span<const EventRange> events() const { return myEvents; };
+        size_t numEvents() const { return myEvents.size(); };
+        const std::vector<std::string> &varNames() const { return myVarNames; };
+        size_t numVariables() const { return myVarNames.size(); };
+        uint32_t numSolvers() const { return myNumSolvers; };
+    };
+}
@@ -134,6 +134,8 @@ namespace QuantScript
     struct NodeIf : public Node
     {
         int firstElse;
+        // Indices of the variables assigned in either branch, set by IfProcessor
+        std::vector<size_t> affectedVars;
         void acceptVisitor(Visitor &visitor) override;
         void acceptVisitor(ConstVisitor &visitor) const override;
     };
@@ -0,0 +1,53 @@
+#include "allocguard.h"
+#include <cstdlib>
+#include <new>
+
+namespace QuantScript
+{
+#ifdef QUANTSCRIPT_CHECK_ALLOCATIONS
+    static thread_local size_t allocations = 0;
+    size_t allocationCount()
+    {
+        return allocations;
+    };
+    static void *countedAlloc(size_t size)
+    {
+        ++allocations;
+        if (void *p = std::malloc(size ? size : 1))
+            return p;
+        throw std::bad_alloc();
+    };
+#else
+    size_t allocationCount()
+    {
+        return 0;
+    };
+#endif
+}
+
+#ifdef QUANTSCRIPT_CHECK_ALLOCATIONS
+void *operator new(size_t size)
+{
+    return QuantScript::countedAlloc(size);
+}
+void *operator new[](size_t size)
+{
+    return QuantScript::countedAlloc(size);
+}
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+void operator delete[](void *p, size_t) noexcept
+{
+    std::free(p);
+}
+#endif
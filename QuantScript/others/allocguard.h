@@ -0,0 +1,24 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+
+namespace QuantScript
+{
+    // Number of heap allocations made by the calling thread. Counted only in
+    // builds with QUANTSCRIPT_CHECK_ALLOCATIONS, which replaces operator new.
+    size_t allocationCount();
+
+    // Asserts that no heap allocation happens on this thread during its lifetime
+    class AllocationGuard
+    {
+        size_t myStart;
+        bool myActive;
+
+    public:
+        AllocationGuard(bool active = true) : myStart(allocationCount()), myActive(active) {};
+        ~AllocationGuard()
+        {
+            assert((!myActive || allocationCount() == myStart) && "heap allocation during evaluate()");
+        };
+    };
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <cstdio>
+
+namespace QuantScript
+{
+    // 64-bit FNV-1a, stable across platforms and runs
+    inline uint64_t fnv1a(std::string_view data, uint64_t seed = 14695981039346656037ull)
+    {
+        uint64_t h = seed;
+        for (unsigned char c : data)
+        {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        return h;
+    };
+    inline std::string toHex(uint64_t h)
+    {
+        char buf[17];
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+        return buf;
+    };
+}
@@ -0,0 +1,85 @@
+#include "mappedfile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace QuantScript
+{
+#ifdef _WIN32
+    MappedFile::MappedFile(const std::string &path)
+    {
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("Cannot open " + path);
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size))
+        {
+            CloseHandle(file);
+            throw std::runtime_error("Cannot stat " + path);
+        }
+        myFile = file;
+        mySize = static_cast<size_t>(size.QuadPart);
+        if (mySize == 0)
+            return;
+        myMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (myMapping)
+            myData = static_cast<const char *>(MapViewOfFile(myMapping, FILE_MAP_READ, 0, 0, 0));
+        if (!myData)
+        {
+            if (myMapping)
+                CloseHandle(myMapping);
+            CloseHandle(file);
+            throw std::runtime_error("Cannot map " + path);
+        }
+    };
+
+    MappedFile::~MappedFile()
+    {
+        if (myData)
+            UnmapViewOfFile(myData);
+        if (myMapping)
+            CloseHandle(myMapping);
+        if (myFile)
+            CloseHandle(myFile);
+    };
+#else
+    MappedFile::MappedFile(const std::string &path)
+    {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("Cannot stat " + path);
+        }
+        mySize = static_cast<size_t>(st.st_size);
+        if (mySize > 0)
+        {
+            void *p = mmap(nullptr, mySize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                close(fd);
+                throw std::runtime_error("Cannot map " + path);
+            }
+            myData = static_cast<const char *>(p);
+        }
+        // The mapping outlives the descriptor
+        close(fd);
+    };
+
+    MappedFile::~MappedFile()
+    {
+        if (myData)
+            munmap(const_cast<char *>(myData), mySize);
+    };
+#endif
+}
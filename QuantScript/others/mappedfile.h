@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace QuantScript
+{
+    // Read-only mapping of a whole file, unmapped on destruction.
+    // Throws std::runtime_error when the file cannot be opened or mapped
+    class MappedFile
+    {
+        const char *myData = nullptr;
+        size_t mySize = 0;
+#ifdef _WIN32
+        void *myFile = nullptr;
+        void *myMapping = nullptr;
+#endif
+
+    public:
+        MappedFile(const std::string &path);
+        ~MappedFile();
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const char *data() const { return myData; };
+        size_t size() const { return mySize; };
+    };
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+
+namespace QuantScript
+{
+    // Stack over a contiguous buffer allocated once. Sized from StackDepth the
+    // buffer never grows, otherwise it doubles when full. pop() does not destroy
+    // the element, so for AAD numbers a push is a plain assignment into a slot.
+    template <class T>
+    class StaticStack
+    {
+        std::unique_ptr<T[]> myData;
+        size_t myCapacity = 0;
+        size_t mySize = 0;
+
+        void grow()
+        {
+            const size_t capacity = 2 * myCapacity + 1;
+            std::unique_ptr<T[]> data(new T[capacity]);
+            for (size_t i = 0; i < mySize; ++i)
+                data[i] = myData[i];
+            myData = std::move(data);
+            myCapacity = capacity;
+        };
+
+    public:
+        StaticStack(size_t capacity = 0) : myData(capacity ? new T[capacity] : nullptr), myCapacity(capacity) {};
+        StaticStack(const StaticStack &rhs) : StaticStack(rhs.myCapacity) {};
+        StaticStack &operator=(const StaticStack &rhs)
+        {
+            if (this != &rhs)
+                *this = StaticStack(rhs.myCapacity);
+            return *this;
+        };
+        StaticStack(StaticStack &&rhs) = default;
+        StaticStack &operator=(StaticStack &&rhs) = default;
+
+        void push(const T &value)
+        {
+            if (mySize == myCapacity)
+                grow();
+            myData[mySize++] = value;
+        };
+        void pop()
+        {
+            --mySize;
+        };
+        T &top()
+        {
+            return myData[mySize - 1];
+        };
+        const T &top() const
+        {
+            return myData[mySize - 1];
+        };
+        bool empty() const
+        {
+            return mySize == 0;
+        };
+        size_t size() const
+        {
+            return mySize;
+        };
+        size_t capacity() const
+        {
+            return myCapacity;
+        };
+        void clear()
+        {
+            mySize = 0;
+        };
+    };
+}
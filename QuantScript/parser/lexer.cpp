@@ -0,0 +1,93 @@
+#include "parser/lexer.h"
+
+namespace QuantScript {
+	static inline bool isWordChar(char c) {
+		return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_' || c == '.';
+	};
+	static inline char upper(char c) {
+		return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+	};
+	static bool equalsUpper(std::string_view word, std::string_view keyword) {
+		if (word.size() != keyword.size()) return false;
+		for (size_t i = 0; i < word.size(); ++i) {
+			if (upper(word[i]) != keyword[i]) return false;
+		}
+		return true;
+	};
+
+	static TokenKind classify(std::string_view word) {
+		struct Keyword { std::string_view name; TokenKind kind; };
+		static constexpr Keyword keywords[] = {
+			{ "IF", TokenKind::If }, { "OR", TokenKind::Or },
+			{ "AND", TokenKind::And }, { "LOG", TokenKind::Log }, { "MIN", TokenKind::Min }, { "MAX", TokenKind::Max },
+			{ "THEN", TokenKind::Then }, { "ELSE", TokenKind::Else }, { "PAYS", TokenKind::Pays },
+			{ "SPOT", TokenKind::Spot }, { "SQRT", TokenKind::Sqrt },
+			{ "ENDIF", TokenKind::EndIf }, { "SOLVE", TokenKind::Solve }
+		};
+		// Keywords are 2 to 5 characters long
+		if (word.size() >= 2 && word.size() <= 5) {
+			for (auto& k : keywords) {
+				if (equalsUpper(word, k.name)) return k.kind;
+			}
+		}
+		return TokenKind::Identifier;
+	};
+
+	std::string upperCase(std::string_view text) {
+		std::string res(text);
+		for (auto& c : res) c = upper(c);
+		return res;
+	};
+
+	std::vector<Token> lex(std::string_view source) {
+		std::vector<Token> tokens;
+		tokens.reserve(source.size() / 2);
+		const char* s = source.data();
+		const size_t n = source.size();
+		size_t i = 0;
+		while (i < n) {
+			const char c = s[i];
+			if (isWordChar(c)) {
+				// Same word definition as the regex tokenizer: [\w.]+
+				size_t j = i + 1;
+				while (j < n && isWordChar(s[j])) ++j;
+				std::string_view word(s + i, j - i);
+				const TokenKind kind = (c == '.' || (c >= '0' && c <= '9')) ? TokenKind::Number : classify(word);
+				tokens.push_back({ kind, word });
+				i = j;
+				continue;
+			}
+			// Two-character comparators first
+			const char next = i + 1 < n ? s[i + 1] : '\0';
+			if (next == '=' && (c == '!' || c == '<' || c == '>')) {
+				tokens.push_back({ c == '!' ? TokenKind::Different : c == '<' ? TokenKind::InfEqual : TokenKind::SupEqual,
+					std::string_view(s + i, 2) });
+				i += 2;
+				continue;
+			}
+			TokenKind kind;
+			switch (c) {
+			case '+': kind = TokenKind::Plus; break;
+			case '-': kind = TokenKind::Minus; break;
+			case '*': kind = TokenKind::Mult; break;
+			case '/': kind = TokenKind::Div; break;
+			case '^': kind = TokenKind::Pow; break;
+			case '(': kind = TokenKind::LParen; break;
+			case ')': kind = TokenKind::RParen; break;
+			case '{': kind = TokenKind::LBrace; break;
+			case '}': kind = TokenKind::RBrace; break;
+			case ',': kind = TokenKind::Comma; break;
+			case '=': kind = TokenKind::Equal; break;
+			case '<': kind = TokenKind::Inferior; break;
+			case '>': kind = TokenKind::Superior; break;
+			default:
+				// Whitespace and characters outside the grammar
+				++i;
+				continue;
+			}
+			tokens.push_back({ kind, std::string_view(s + i, 1) });
+			++i;
+		}
+		return tokens;
+	};
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace QuantScript
+{
+	enum class TokenKind : uint8_t
+	{
+		// Literals and names
+		Number,
+		Identifier,
+		// Keywords
+		If,
+		Then,
+		Else,
+		EndIf,
+		Pays,
+		And,
+		Or,
+		// Functions
+		Spot,
+		Solve,
+		Log,
+		Sqrt,
+		Min,
+		Max,
+		// Operators and punctuation
+		Plus,
+		Minus,
+		Mult,
+		Div,
+		Pow,
+		LParen,
+		RParen,
+		LBrace,
+		RBrace,
+		Comma,
+		Equal,
+		Different,
+		Inferior,
+		Superior,
+		InfEqual,
+		SupEqual
+	};
+
+	// Token over the source text, keywords are classified case-insensitively
+	// so the text keeps the original case
+	struct Token
+	{
+		TokenKind kind;
+		std::string_view text;
+	};
+
+	// Splits a script into tokens, the source must outlive them.
+	// Characters outside the grammar are skipped
+	std::vector<Token> lex(std::string_view source);
+
+	// Upper-cased copy of a token text, as used for variable names
+	std::string upperCase(std::string_view text);
+
+	inline bool isComparator(TokenKind kind)
+	{
+		return kind >= TokenKind::Equal && kind <= TokenKind::SupEqual;
+	};
+}
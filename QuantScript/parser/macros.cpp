@@ -0,0 +1,142 @@
+#include "parser/macros.h"
+#include "parser/parser.h"
+#include <algorithm>
+
+namespace QuantScript {
+	MacroTable::MacroTable(const std::map<std::string, std::string>& macroMap) {
+		for (auto& macro : macroMap) {
+			define(macro.first, macro.second);
+		}
+	};
+
+	void MacroTable::define(const std::string& signature, const std::string& body) {
+		const auto sig = lex(signature);
+		if (sig.empty() || sig[0].kind != TokenKind::Identifier)
+			throw script_error(("Invalid macro signature " + signature).c_str());
+		const std::string name = upperCase(sig[0].text);
+		// The body tokens view into the stored source, so it is set in place
+		Macro& macro = myMacros[name];
+		macro = Macro();
+		if (sig.size() > 1) {
+			macro.isFunction = true;
+			// NAME ( [A {, B}] )
+			bool valid = sig[1].kind == TokenKind::LParen && sig.back().kind == TokenKind::RParen;
+			for (size_t i = 2; valid && i + 1 < sig.size(); ++i) {
+				const bool expectName = i % 2 == 0;
+				if (expectName && sig[i].kind == TokenKind::Identifier)
+					macro.params.push_back(upperCase(sig[i].text));
+				else if (expectName || sig[i].kind != TokenKind::Comma)
+					valid = false;
+			}
+			if (!valid || (sig.size() > 3 && sig.size() % 2 != 0)) {
+				myMacros.erase(name);
+				throw script_error(("Invalid macro signature " + signature).c_str());
+			}
+		}
+		macro.source = body;
+		macro.body = lex(macro.source);
+	};
+
+	const MacroTable::Macro* MacroTable::find(std::string_view name, std::string& key) const {
+		key.assign(name.begin(), name.end());
+		std::transform(key.begin(), key.end(), key.begin(), ::toupper);
+		auto it = myMacros.find(key);
+		return it == myMacros.end() ? nullptr : &it->second;
+	};
+
+	void MacroTable::expand(const Token* cur, const Token* end, std::vector<Token>& out, std::vector<const Macro*>& active) const {
+		std::string key;
+		while (cur != end) {
+			const Macro* macro = cur->kind == TokenKind::Identifier ? find(cur->text, key) : nullptr;
+			if (!macro || std::find(active.begin(), active.end(), macro) != active.end()) {
+				out.push_back(*cur);
+				++cur;
+				continue;
+			}
+			if (!macro->isFunction) {
+				active.push_back(macro);
+				expand(macro->body.data(), macro->body.data() + macro->body.size(), out, active);
+				active.pop_back();
+				++cur;
+				continue;
+			}
+			// A function macro name without arguments is left alone
+			const Token* open = cur + 1;
+			if (open == end || open->kind != TokenKind::LParen) {
+				out.push_back(*cur);
+				++cur;
+				continue;
+			}
+			// Split arguments on top-level commas
+			std::vector<TokenRange> args;
+			const Token* argStart = open + 1;
+			const Token* it = open + 1;
+			unsigned depth = 0;
+			for (; it != end; ++it) {
+				if (it->kind == TokenKind::LParen)
+					++depth;
+				else if (it->kind == TokenKind::RParen) {
+					if (depth == 0) break;
+					--depth;
+				}
+				else if (it->kind == TokenKind::Comma && depth == 0) {
+					args.push_back({ argStart, it });
+					argStart = it + 1;
+				}
+			}
+			if (it == end)
+				throw script_error("Opening ( has not matching closing )");
+			if (argStart != it || !args.empty())
+				args.push_back({ argStart, it });
+			if (args.size() != macro->params.size())
+				throw script_error("Script Macro call does not match its definition (Check Macro def or script call).");
+
+			// Expand the arguments in the calling context, then bind them
+			std::vector<std::vector<Token>> bound(args.size());
+			for (size_t i = 0; i < args.size(); ++i)
+				expand(args[i].first, args[i].second, bound[i], active);
+			std::vector<Token> substituted;
+			substituted.reserve(macro->body.size());
+			for (auto& tok : macro->body) {
+				size_t p = macro->params.size();
+				if (tok.kind == TokenKind::Identifier) {
+					key.assign(tok.text.begin(), tok.text.end());
+					std::transform(key.begin(), key.end(), key.begin(), ::toupper);
+					p = std::find(macro->params.begin(), macro->params.end(), key) - macro->params.begin();
+				}
+				if (p < macro->params.size()) {
+					// Compound arguments are parenthesised so that X*2 with X = A+B binds as (A+B)*2,
+					// single tokens stay bare and can still be assigned to
+					const bool wrap = bound[p].size() > 1;
+					if (wrap) substituted.push_back({ TokenKind::LParen, "(" });
+					substituted.insert(substituted.end(), bound[p].begin(), bound[p].end());
+					if (wrap) substituted.push_back({ TokenKind::RParen, ")" });
+				}
+				else
+					substituted.push_back(tok);
+			}
+			active.push_back(macro);
+			expand(substituted.data(), substituted.data() + substituted.size(), out, active);
+			active.pop_back();
+			cur = it + 1;
+		}
+	};
+
+	std::vector<Token> MacroTable::expandTokens(std::string_view script) const {
+		const auto tokens = lex(script);
+		std::vector<Token> out;
+		out.reserve(tokens.size());
+		std::vector<const Macro*> active;
+		expand(tokens.data(), tokens.data() + tokens.size(), out, active);
+		return out;
+	};
+
+	std::string MacroTable::expand(const std::string& script) const {
+		std::string res;
+		for (auto& tok : expandTokens(script)) {
+			if (!res.empty()) res += ' ';
+			res.append(tok.text.begin(), tok.text.end());
+		}
+		return res;
+	};
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "parser/lexer.h"
+
+namespace QuantScript
+{
+	// Macro definitions compiled once and expanded at token level.
+	// Constants are defined as NAME -> body and functions as NAME(A,B) -> body,
+	// names and parameters match whole identifiers, case-insensitively.
+	// Expansion is a single pass over the tokens: arguments are expanded first,
+	// bound to the parameters, and the result is rescanned for nested macros.
+	// A macro is not expanded again inside its own expansion.
+	class MacroTable
+	{
+		struct Macro
+		{
+			std::string source;
+			std::vector<std::string> params;
+			std::vector<Token> body;
+			bool isFunction = false;
+		};
+		using TokenRange = std::pair<const Token *, const Token *>;
+
+		std::unordered_map<std::string, Macro> myMacros;
+
+		const Macro *find(std::string_view name, std::string &key) const;
+		void expand(const Token *cur, const Token *end, std::vector<Token> &out, std::vector<const Macro *> &active) const;
+
+	public:
+		MacroTable() {};
+		MacroTable(const std::map<std::string, std::string> &macroMap);
+		// Body tokens view into the sources of this table, a copy would view into the original.
+		// Moves keep the map nodes, and the sources with them, in place
+		MacroTable(const MacroTable &) = delete;
+		MacroTable &operator=(const MacroTable &) = delete;
+		MacroTable(MacroTable &&) = default;
+		MacroTable &operator=(MacroTable &&) = default;
+		// Signature is NAME or NAME(A,B,...)
+		void define(const std::string &signature, const std::string &body);
+		bool empty() const { return myMacros.empty(); };
+
+		// Expanded tokens, they view into the script and the table which must both outlive them
+		std::vector<Token> expandTokens(std::string_view script) const;
+		// Expanded script as text, tokens separated by spaces
+		std::string expand(const std::string &script) const;
+	};
+}
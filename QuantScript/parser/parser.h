@@ -1,10 +1,13 @@
 #pragma once
 
-#include <regex>
+#include <stdexcept>
 #include <algorithm>
 #include <map>
+#include <charconv>
+#include <cctype>
 
 #include "nodes/nodes.h"
+#include "parser/lexer.h"
 
 namespace QuantScript
 {
@@ -14,22 +17,28 @@ namespace QuantScript
 		script_error(const char msg[]) : std::runtime_error(msg) {}
 	};
 
-	std::vector<std::string> tokenize(const std::string &str);
+	class MacroTable;
+
 	Event parse(const std::string &eventString);
+	// Parse after expanding macros, the table can be shared across scripts
+	Event parse(const std::string &eventString, const MacroTable &macros);
 	std::string macroReplacer(const std::map<std::string, std::string> &macroMap, const std::string &eventString);
-	std::string macroVarReplacer(const std::vector<std::string> &macroArgs, const std::vector<std::string> &scriptArgs, const std::string &funcString);
-	std::vector<std::string> getMacroFuncArgs(const std::string &funcString, const std::regex &parametersRegex);
-	std::vector<std::string> scriptVarSplit(const std::string &s, const std::string &funcSignature);
 
+	// Recursive descent over lexer tokens, TokIt iterates over Token
 	template <class TokIt>
 	class Parser
 	{
+		static std::string text(TokIt cur)
+		{
+			return std::string(cur->text);
+		};
+
 	public:
 		// Statement = ExprTree = unique_ptr<Node>
 		static Statement parseStatement(TokIt &cur, const TokIt end)
 		{
 			// Check for instructions of type 1, so far only ’if’
-			if (*cur == "IF")
+			if (cur->kind == TokenKind::If)
 				return parseIf(cur, end);
 			// Parse cur as a variable
 			auto lhs = parseVar(cur);
@@ -37,9 +46,9 @@ namespace QuantScript
 			if (cur == end)
 				throw script_error("Unexpected end of statement");
 			// Check for instructions of type 2, so far only assignment
-			if (*cur == "PAYS")
+			if (cur->kind == TokenKind::Pays)
 				return parsePays(cur, end, lhs);
-			if (*cur == "=")
+			if (cur->kind == TokenKind::Equal)
 				return parseAssign(cur, end, lhs);
 			// No instruction, error
 			throw script_error("Statement without an instruction");
@@ -56,99 +65,92 @@ namespace QuantScript
 			// Build and return the top node
 			return buildBinary<NodePays>(lhs, rhs);
 		}
-                static ExpressionTree parseIf(TokIt &cur, const TokIt end)
-                {
-                        // Advance to token immediately following "if"
-                        ++cur;
-                        // Check for end
-                        if (cur == end)
-                                throw script_error("'If' is not followed by condition");
-                        // Parse the condition
-                        auto cond = parseCondElem(cur, end);
-
-                        if (cur == end)
-                                throw script_error("'If' has no body");
-
-                        bool useBraces = false;
-                        if (*cur == "THEN")
-                        {
-                                ++cur;
-                        }
-                        else if (*cur == "{")
-                        {
-                                useBraces = true;
-                                ++cur;
-                        }
-                        else
-                                throw script_error("'If' is not followed by 'then' or '{'");
-
-                        std::vector<Statement> stats;
-                        while (cur != end && *cur != "ELSE" && *cur != (useBraces ? "}" : "ENDIF"))
-                                stats.push_back(parseStatement(cur, end));
-
-                        if (cur == end)
-                                throw script_error("If block not terminated");
+		// Statements up to (excluding) one of the given terminators
+		static std::vector<Statement> parseBlock(TokIt &cur, const TokIt end, TokenKind term1, TokenKind term2)
+		{
+			std::vector<Statement> stats;
+			while (cur != end && cur->kind != term1 && cur->kind != term2)
+				stats.push_back(parseStatement(cur, end));
+			return stats;
+		};
+		static ExpressionTree parseIf(TokIt &cur, const TokIt end)
+		{
+			// Advance to token immediately following "if"
+			++cur;
+			// Check for end
+			if (cur == end)
+				throw script_error("'If' is not followed by condition");
+			// Parse the condition
+			auto cond = parseCond(cur, end);
 
-                        std::vector<Statement> elseStats;
-                        int elseIdx = -1;
+			if (cur == end)
+				throw script_error("'If' has no body");
 
-                        if (*cur == "ELSE")
-                        {
-                                ++cur;
-                                bool elseBraces = false;
-                                if (useBraces)
-                                {
-                                        if (cur == end || *cur != "{")
-                                                throw script_error("Else block must start with '{'");
-                                        elseBraces = true;
-                                        ++cur;
-                                }
-                                while (cur != end && *cur != (elseBraces ? "}" : "ENDIF"))
-                                        elseStats.push_back(parseStatement(cur, end));
-                                if (cur == end)
-                                        throw script_error("Else block not terminated");
-                                if (elseBraces)
-                                        ++cur; // over '}'
-                                else
-                                        ; // ENDIF consumed later
-                                elseIdx = stats.size() + 1;
-                        }
+			std::vector<Statement> stats, elseStats;
+			bool hasElse = false;
+			if (cur->kind == TokenKind::Then)
+			{
+				// IF ... THEN ... [ELSE ...] ENDIF
+				++cur;
+				stats = parseBlock(cur, end, TokenKind::Else, TokenKind::EndIf);
+				if (cur == end)
+					throw script_error("If block not terminated");
+				if (cur->kind == TokenKind::Else)
+				{
+					++cur;
+					hasElse = true;
+					elseStats = parseBlock(cur, end, TokenKind::EndIf, TokenKind::EndIf);
+					if (cur == end)
+						throw script_error("Else block not terminated");
+				}
+				++cur; // over ENDIF
+			}
+			else if (cur->kind == TokenKind::LBrace)
+			{
+				// IF ... { ... } [ELSE { ... }]
+				++cur;
+				stats = parseBlock(cur, end, TokenKind::RBrace, TokenKind::RBrace);
+				if (cur == end)
+					throw script_error("If block not terminated");
+				++cur; // over '}'
+				if (cur != end && cur->kind == TokenKind::Else)
+				{
+					++cur;
+					if (cur == end || cur->kind != TokenKind::LBrace)
+						throw script_error("Else block must start with '{'");
+					++cur;
+					hasElse = true;
+					elseStats = parseBlock(cur, end, TokenKind::RBrace, TokenKind::RBrace);
+					if (cur == end)
+						throw script_error("Else block not terminated");
+					++cur; // over '}'
+				}
+			}
+			else
+				throw script_error("'If' is not followed by 'then' or '{'");
 
-                        auto top = make_node<NodeIf>();
-                        top->arguments.resize(1 + stats.size() + elseStats.size());
-                        top->arguments[0] = std::move(cond);
+			const int elseIdx = hasElse ? static_cast<int>(stats.size()) + 1 : -1;
 
-                        for (size_t i = 0; i < stats.size(); ++i)
-                                top->arguments[i + 1] = std::move(stats[i]);
+			auto top = make_node<NodeIf>();
+			top->arguments.resize(1 + stats.size() + elseStats.size());
+			top->arguments[0] = std::move(cond);
 
-                        for (size_t i = 0; i < elseStats.size(); ++i)
-                                top->arguments[i + elseIdx] = std::move(elseStats[i]);
+			for (size_t i = 0; i < stats.size(); ++i)
+				top->arguments[i + 1] = std::move(stats[i]);
 
-                        top->firstElse = elseIdx;
+			for (size_t i = 0; i < elseStats.size(); ++i)
+				top->arguments[i + elseIdx] = std::move(elseStats[i]);
 
-                        if (*cur == "ENDIF")
-                        {
-                                ++cur;
-                        }
-                        else if (*cur == "}")
-                        {
-                                ++cur;
-                                if (elseIdx != -1 && cur != end && *cur == "ENDIF")
-                                        ++cur; // support mixed '}' before ENDIF if else had no braces
-                        }
-                        else
-                        {
-                                // if we reached here, termination token is part of else parsing
-                        }
-                        return std::move(top);
-                };
+			top->firstElse = elseIdx;
+			return std::move(top);
+		};
 		static ExpressionTree parseVar(TokIt &cur)
 		{
 			// Check that the variable name starts with a letter
-			if ((*cur)[0] < 'A' || (*cur)[0] > 'Z')
-				throw script_error((std::string("Variable name ") + *cur + " is invalid").c_str());
-			// Build the var node
-			auto top = make_node<NodeVar>(*cur);
+			if (cur->kind != TokenKind::Identifier || !std::isalpha(static_cast<unsigned char>(cur->text[0])))
+				throw script_error((std::string("Variable name ") + upperCase(cur->text) + " is invalid").c_str());
+			// Build the var node, names are case-insensitive
+			auto top = make_node<NodeVar>(upperCase(cur->text));
 			// Advance over var and return
 			++cur;
 			return std::move(top);
@@ -175,7 +177,7 @@ namespace QuantScript
 			// conditions on the lhs
 			auto lhs = parseCondL2(cur, end);
 			// Do we have an ’or’?
-			while (cur != end && *cur == "OR")
+			while (cur != end && cur->kind == TokenKind::Or)
 			{
 				// Advance cur over ’or’ and parse the rhs
 				++cur;
@@ -202,7 +204,7 @@ namespace QuantScript
 			if (cur == end)
 				throw script_error("Unexpected end of statement");
 			// Advance to token immediately following the comparator
-			std::string comparator = *cur;
+			const TokenKind comparator = cur->kind;
 			++cur;
 			// Check for end
 			if (cur == end)
@@ -210,41 +212,43 @@ namespace QuantScript
 			// Parse the RHS
 			auto rhs = parseExpr(cur, end);
 			// Build the top node, set its arguments and return
-			if (comparator == "=")
+			switch (comparator)
+			{
+			case TokenKind::Equal:
 				return buildBinary<NodeEqual>(lhs, rhs);
-			else if (comparator == "!=")
+			case TokenKind::Different:
 				return buildBinary<NodeDifferent>(lhs, rhs);
-			else if (comparator == "<")
+			case TokenKind::Inferior:
 				return buildBinary<NodeInferior>(lhs, rhs);
-			else if (comparator == ">")
+			case TokenKind::Superior:
 				return buildBinary<NodeSuperior>(lhs, rhs);
-			else if (comparator == "<=")
+			case TokenKind::InfEqual:
 				return buildBinary<NodeInfEqual>(lhs, rhs);
-			else if (comparator == ">=")
+			case TokenKind::SupEqual:
 				return buildBinary<NodeSupEqual>(lhs, rhs);
-			else
+			default:
 				throw script_error("Elementary condition has no valid comparator");
+			}
 		};
-		template <char OpChar, char ClChar>
 		static TokIt findMatch(TokIt cur, const TokIt end)
 		{
 			unsigned opens = 1;
 			++cur;
 			while (cur != end && opens > 0)
 			{
-				opens += ((*cur)[0] == OpChar) - ((*cur)[0] == ClChar);
+				opens += (cur->kind == TokenKind::LParen) - (cur->kind == TokenKind::RParen);
 				++cur;
 			}
 			if (cur == end && opens > 0)
-				throw script_error((std::string("Opening ") + OpChar + " has not matching closing " + ClChar).c_str());
+				throw script_error("Opening ( has not matching closing )");
 			return --cur;
 		};
 		static ExpressionTree parseCondL2(TokIt &cur, const TokIt end)
 		{
 			// First parse the leftmost elem condition
-			auto lhs = parseCondElem(cur, end);
+			auto lhs = parseCondParentheses(cur, end);
 			// Do we have an ’and’?
-			while (cur != end && *cur == "AND")
+			while (cur != end && cur->kind == TokenKind::And)
 			{
 				// Advance cur over ’and’ and parse the rhs
 				++cur;
@@ -252,7 +256,7 @@ namespace QuantScript
 				if (cur == end)
 					throw script_error("Unexpected end of statement");
 				// Parse the rhs elem condition
-				auto rhs = parseCondElem(cur, end);
+				auto rhs = parseCondParentheses(cur, end);
 				// Build node and assign lhs and rhs as its arguments,
 				// store in lhs
 				lhs = buildBinary<NodeAnd>(lhs, rhs);
@@ -265,31 +269,36 @@ namespace QuantScript
 		static ExpressionTree parseCondParentheses(TokIt &cur, const TokIt end)
 		{
 			ExpressionTree tree;
-			// Do we have an opening ’(’?
-			if (*cur == "(")
+			// Do we have an opening ’(’ around a condition?
+			// In (A + B) > 0 it opens an expression instead,
+			// expressions never contain a comparator
+			if (cur->kind == TokenKind::LParen)
 			{
 				// Find match
-				TokIt closeIt = findMatch<"(", ")">(cur, end);
-				// Parse the parenthesed condition,
-				// including nested parentheses,
-				// by recursively calling the parent parseCond
-				tree = parseCond(++cur, closeIt);
-				// Advance cur after matching )
-				cur = ++closeIt;
+				TokIt closeIt = findMatch(cur, end);
+				bool isCondition = false;
+				for (TokIt it = cur; it != closeIt && !isCondition; ++it)
+					isCondition = isComparator(it->kind);
+				if (isCondition)
+				{
+					// Parse the parenthesed condition,
+					// including nested parentheses,
+					// by recursively calling the parent parseCond
+					tree = parseCond(++cur, closeIt);
+					if (cur != closeIt)
+						throw script_error("Unexpected token in condition");
+					// Advance cur after matching )
+					cur = ++closeIt;
+					return tree;
+				}
 			}
-			else
-			{
-				// No (, so leftmost we std::move one level up
-				tree = parseCondElem(cur, end);
-			}
-			return tree;
+			// No (, so leftmost we std::move one level up
+			return parseCondElem(cur, end);
 		};
 		static ExpressionTree parseVarConstFunc(TokIt &cur, const TokIt end)
 		{
-			// First check for constants,
-			// if the char is a digit or a dot,
-			// then we have a number
-			if ((*cur)[0] == '.' || ((*cur)[0] >= '0' && (*cur)[0] <= '9'))
+			// First check for constants
+			if (cur->kind == TokenKind::Number)
 			{
 				return parseConst(cur);
 			}
@@ -300,46 +309,47 @@ namespace QuantScript
 			unsigned minArg = 0;
 			unsigned maxArg = 0;
 
-			if (*cur == "SPOT")
+			switch (cur->kind)
 			{
+			case TokenKind::Spot:
 				top = make_base_node<NodeSpot>();
 				minArg = maxArg = 0;
-			}
-			else if (*cur == "SOLVE")
-			{
+				break;
+			case TokenKind::Solve:
 				top = make_base_node<NodeSolver>();
 				minArg = maxArg = 0;
-			}
-			else if (*cur == "LOG")
-			{
+				break;
+			case TokenKind::Log:
 				top = make_base_node<NodeLog>();
 				minArg = maxArg = 1;
-			}
-			else if (*cur == "SQRT")
-			{
+				break;
+			case TokenKind::Sqrt:
 				top = make_base_node<NodeSqrt>();
 				minArg = maxArg = 1;
-			}
-			else if (*cur == "MIN")
-			{
+				break;
+			case TokenKind::Min:
 				top = make_base_node<NodeMin>();
 				minArg = 2;
 				maxArg = 100;
-			}
-			else if (*cur == "MAX")
-			{
+				break;
+			case TokenKind::Max:
 				top = make_base_node<NodeMax>();
 				minArg = 2;
 				maxArg = 100;
+				break;
+			default:
+				break;
 			}
 			if (top)
 			{
-				std::string func = *cur;
+				TokIt func = cur;
 				++cur;
+				if (cur == end)
+					throw script_error("No opening ( following function name");
 				// Matched a function, parse its arguments and check
 				top->arguments = parseFuncArg(cur, end);
 				if (top->arguments.size() < minArg || top->arguments.size() > maxArg)
-					throw script_error((std::string("Function ") + func + ": wrong number of arguments").c_str());
+					throw script_error((std::string("Function ") + upperCase(func->text) + ": wrong number of arguments").c_str());
 				// Return
 				return top;
 			}
@@ -350,16 +360,13 @@ namespace QuantScript
 
 		static ExpressionTree parseConst(TokIt &cur)
 		{
-			// Convert to double
+			// Convert to double, the whole token must be consumed
 			double v;
-			try
-			{
-				v = std::stod(*cur);
-			}
-			catch (const std::exception &)
-			{
-				throw script_error((*cur + " is not a number").c_str());
-			}
+			const char *first = cur->text.data();
+			const char *last = first + cur->text.size();
+			auto res = std::from_chars(first, last, v);
+			if (res.ec != std::errc() || res.ptr != last)
+				throw script_error((text(cur) + " is not a number").c_str());
 			// Build the const node
 			auto top = make_node<NodeConst>(v);
 			// Advance over var and return
@@ -371,19 +378,21 @@ namespace QuantScript
 		static std::vector<ExpressionTree> parseFuncArg(TokIt &cur, const TokIt end)
 		{
 			// Check that we have a ’(’ and something after that
-			if ((*cur)[0] != '(')
+			if (cur->kind != TokenKind::LParen)
 				throw script_error("No opening ( following function name");
 			// Find matching ’)’
-			TokIt closeIt = findMatch<'(', ')'>(cur, end);
+			TokIt closeIt = findMatch(cur, end);
 			// Parse expressions between parentheses
 			std::vector<ExpressionTree> args;
 			++cur; // Over ’(’
 			while (cur != closeIt)
 			{
-				args.push_back(parseExpr(cur, end));
-				if ((*cur)[0] == ',')
+				args.push_back(parseExpr(cur, closeIt));
+				if (cur == closeIt)
+					break;
+				if (cur->kind == TokenKind::Comma)
 					++cur;
-				else if (cur != closeIt)
+				else
 					throw script_error("Arguments must be separated by commas");
 			};
 			// Advance and return
@@ -396,14 +405,16 @@ namespace QuantScript
 		{
 			ExpressionTree tree;
 			// Do we have an opening ’(’?
-			if (*cur == "(")
+			if (cur->kind == TokenKind::LParen)
 			{
 				// Find match
-				TokIt closeIt = findMatch<'(', ')'>(cur, end);
+				TokIt closeIt = findMatch(cur, end);
 				// Parse the parenthesed condition/expression,
 				// including nested parentheses,
 				// by recursively calling the parent parseCond/parseExpr
 				tree = FuncOnMatch(++cur, closeIt);
+				if (cur != closeIt)
+					throw script_error("Unexpected token in parentheses");
 				// Advance cur after matching )
 				cur = ++closeIt;
 			}
@@ -417,14 +428,16 @@ namespace QuantScript
 
 		static ExpressionTree parseExpr(TokIt &cur, const TokIt end)
 		{
+			if (cur == end)
+				throw script_error("Unexpected end of statement");
 			// First exhaust all L2 (’*’ and ’/’)
 			// and above expressions on the lhs
 			auto lhs = parseExprL2(cur, end);
 			// Do we have a match?
-			while (cur != end && ((*cur)[0] == '+' || (*cur)[0] == '-'))
+			while (cur != end && (cur->kind == TokenKind::Plus || cur->kind == TokenKind::Minus))
 			{
 				// Record operator and advance
-				char op = (*cur)[0];
+				const bool plus = cur->kind == TokenKind::Plus;
 				++cur;
 				// Should not stop straight after operator
 				if (cur == end)
@@ -434,7 +447,7 @@ namespace QuantScript
 				auto rhs = Parser<TokIt>::parseExprL2(cur, end);
 				// Build node and assign lhs and rhs as its arguments,
 				// store in lhs
-				lhs = op == '+' ? buildBinary<NodeAdd>(lhs, rhs) : buildBinary<NodeSubtract>(lhs, rhs);
+				lhs = plus ? buildBinary<NodeAdd>(lhs, rhs) : buildBinary<NodeSubtract>(lhs, rhs);
 			}
 			// No more match, return lhs
 			return lhs;
@@ -445,10 +458,10 @@ namespace QuantScript
 			// and above expressions on the lhs
 			auto lhs = parseExprL3(cur, end);
 			// Do we have a match?
-			while (cur != end && ((*cur)[0] == '*' || (*cur)[0] == '/'))
+			while (cur != end && (cur->kind == TokenKind::Mult || cur->kind == TokenKind::Div))
 			{
 				// Record operator and advance
-				char op = (*cur)[0];
+				const bool mult = cur->kind == TokenKind::Mult;
 				++cur;
 				// Should not stop straight after operator
 				if (cur == end)
@@ -458,7 +471,7 @@ namespace QuantScript
 				auto rhs = Parser<TokIt>::parseExprL3(cur, end);
 				// Build node and assign lhs and rhs as its arguments,
 				// store in lhs
-				lhs = op == '*' ? buildBinary<NodeMult>(lhs, rhs) : buildBinary<NodeDiv>(lhs, rhs);
+				lhs = mult ? buildBinary<NodeMult>(lhs, rhs) : buildBinary<NodeDiv>(lhs, rhs);
 			}
 			// No more match, return lhs
 			return lhs;
@@ -469,7 +482,7 @@ namespace QuantScript
 			// and above expressions on the lhs
 			auto lhs = parseExprL4(cur, end);
 			// Do we have a match?
-			while (cur != end && (*cur)[0] == '^')
+			while (cur != end && cur->kind == TokenKind::Pow)
 			{
 				// Advance
 				++cur;
@@ -489,10 +502,10 @@ namespace QuantScript
 		static ExpressionTree parseExprL4(TokIt &cur, const TokIt end)
 		{
 			// Here we check for a match first
-			if (cur != end && ((*cur)[0] == '+' || (*cur)[0] == '-'))
+			if (cur != end && (cur->kind == TokenKind::Plus || cur->kind == TokenKind::Minus))
 			{
 				// Record operator and advance
-				char op = (*cur)[0];
+				const bool plus = cur->kind == TokenKind::Plus;
 				++cur;
 				// Should not stop straight after operator
 				if (cur == end)
@@ -501,16 +514,18 @@ namespace QuantScript
 				// to support multiple unaries in a row
 				auto rhs = parseExprL4(cur, end);
 				// Build node and assign rhs as its (only) argument
-				auto top = op == '+' ? make_base_node<NodeUplus>() : make_base_node<NodeUminus>();
+				auto top = plus ? make_base_node<NodeUplus>() : make_base_node<NodeUminus>();
 				top->arguments.resize(1);
 				// Take ownership of rhs
-				top->arguments[0] = move(rhs);
+				top->arguments[0] = std::move(rhs);
 				// Return the top node
 				return top;
 			}
+			if (cur == end)
+				throw script_error("Unexpected end of statement");
 			// No more match,
 			// we pass on to the L5 (parentheses) parser
 			return parseParentheses<parseExpr, parseVarConstFunc>(cur, end);
 		};
 	};
-};
\ No newline at end of file
+};
@@ -0,0 +1,253 @@
+#pragma once
+#include "product/product.h"
+#include "models/models.h"
+#include "product/parallelval.h"
+#include "product/statistics.h"
+#include <automatic/aad.h>
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace QuantScript
+{
+    // Values and risks of a script valued with AAD
+    struct ScriptRisks
+    {
+        // Average of every variable, in the order of Product::varNames
+        std::vector<double> values;
+        // Means and standard errors of the variables over the paths, values are its means
+        PathStatistics statistics;
+        // Derivatives of the average of the target variable to each model parameter
+        std::vector<double> risks;
+        std::vector<std::string> parameterLabels;
+    };
+
+    // Check that prd is not flattened and process its ifs for fuzzy evaluation
+    inline void prepareFuzzy(Product &prd)
+    {
+        if (prd.sharedFlat())
+            throw std::runtime_error("Fuzzy evaluation needs the event trees, do not flatten the product");
+        prd.processIfs();
+    };
+
+    // Fuzzy evaluator of a product that is not flattened
+    inline std::unique_ptr<Evaluator<Number>> buildFuzzy(Product &prd, const double fuzzyWidth)
+    {
+        prepareFuzzy(prd);
+        return prd.buildFuzzyEvaluator<Number>(fuzzyWidth);
+    };
+
+    // Monte-Carlo value and risks of the target variable of prd, with the mcSimulAAD pattern:
+    // parameters and model precalculations are recorded once and the tape is marked, then each
+    // path rewinds to the mark, evaluates and propagates to the mark. Adjoints above the mark
+    // accumulate over paths and are propagated to the parameters once at the end, so tape
+    // memory does not grow with the number of paths. Uses and clears the tape of the caller.
+    // With a positive fuzzyWidth, conditions are smoothed by a FuzzyEvaluator of that width
+    inline ScriptRisks scriptValAAD(Product &prd, const Model<Number> &model, const RandomGen &random,
+                                    const size_t numSim, const std::string &target, const double fuzzyWidth = 0.0)
+    {
+        const size_t nVar = prd.varNames().size();
+        const size_t idx = targetIndex(prd, target);
+        auto mdl = model.clone();
+        auto rng = random.clone();
+
+        Tape &tape = *Number::tape;
+        tape.clear();
+        auto resetter = setNumResultsForAAD();
+        const std::vector<Number *> params = mdl->parameters();
+        for (Number *p : params)
+            p->putOnTape();
+        // Model precalculations go on tape before the mark
+        ScriptSimulator<Number> simulator(*mdl, *rng);
+        simulator.initForScripting(prd.eventDates());
+        auto scenario = prd.buildScenario<Number>();
+        std::unique_ptr<Evaluator<Number>> tree;
+        std::unique_ptr<FlatEvaluator<Number>> flat;
+        if (fuzzyWidth > 0.0)
+            tree = buildFuzzy(prd, fuzzyWidth);
+        else if (prd.sharedFlat())
+            flat = prd.buildFlatEvaluator<Number>();
+        else
+            tree = prd.buildEvaluator<Number>();
+        tape.mark();
+
+        ScriptRisks results;
+        results.statistics = PathStatistics(nVar);
+        for (size_t i = 0; i < numSim; ++i)
+        {
+            tape.rewindToMark();
+            simulator.nextScenario(*scenario);
+            const std::vector<Number> *vals;
+            if (flat)
+            {
+                flat->init();
+                prd.evaluate(*scenario, *flat);
+                vals = &flat->variables();
+            }
+            else
+            {
+                tree->init();
+                prd.evaluate(*scenario, *tree);
+                vals = &tree->variables();
+            }
+            Number result = (*vals)[idx];
+            result.propagateToMark();
+            results.statistics.add(*vals);
+        }
+        Number::propagateMarkToStart();
+
+        results.values = results.statistics.means();
+        for (Number *p : params)
+            results.risks.push_back(p->adjoint() / double(numSim));
+        results.parameterLabels = mdl->parameterLabels();
+        tape.clear();
+        return results;
+    };
+
+    // Parallel scriptValAAD in the way of mcParallelSimulAAD: batches of paths run on the
+    // ThreadPool, each thread records its own model clone on its own Tape and marks it on its
+    // first batch, then rewinds to the mark on every path. At the end each tape is propagated
+    // from its mark to the start and the adjoints of the clones' parameters are summed.
+    // Values are identical whatever the number of threads, risks up to the order of the sum
+    inline ScriptRisks parallelScriptValAAD(Product &prd, const Model<Number> &model, const RandomGen &random,
+                                            const size_t numSim, const std::string &target,
+                                            const double fuzzyWidth = 0.0, const size_t batchSize = SCRIPT_BATCHSIZE)
+    {
+        const size_t nVar = prd.varNames().size();
+        const size_t idx = targetIndex(prd, target);
+        // Processed here, tasks only read the product
+        if (fuzzyWidth > 0.0)
+            prepareFuzzy(prd);
+        const size_t numBatch = (numSim + batchSize - 1) / batchSize;
+
+        ThreadPool *pool = ThreadPool::getInstance();
+        const size_t nThread = pool->numThreads() + 1; // +1 for the caller
+
+        struct Workspace
+        {
+            std::unique_ptr<Model<Number>> model;
+            std::unique_ptr<RandomGen> random;
+            std::unique_ptr<ScriptSimulator<Number>> simulator;
+            std::unique_ptr<Scenario<Number>> scenario;
+            std::unique_ptr<Evaluator<Number>> tree;
+            std::unique_ptr<FlatEvaluator<Number>> flat;
+            size_t position = 0;
+            // Not vector<bool>, written from different threads
+            bool initialised = false;
+        };
+        std::vector<Workspace> workspaces(nThread);
+        for (auto &ws : workspaces)
+        {
+            ws.model = model.clone();
+            ws.random = random.clone();
+            ws.random->skipAhead(0);
+        }
+        // The caller keeps its own tape, workers use these
+        std::vector<Tape> tapes(nThread - 1);
+        Tape *mainTape = Number::tape;
+        mainTape->clear();
+        auto resetter = setNumResultsForAAD();
+
+        std::vector<PathStatistics> batchStats(numBatch, PathStatistics(nVar));
+        std::vector<TaskHandle> futures;
+        futures.reserve(numBatch);
+        for (size_t b = 0; b < numBatch; ++b)
+        {
+            futures.push_back(pool->spawnTask([&, b]()
+            {
+                const size_t threadNum = ThreadPool::threadNum();
+                if (threadNum > 0)
+                    Number::tape = &tapes[threadNum - 1];
+                Workspace &ws = workspaces[threadNum];
+                if (!ws.initialised)
+                {
+                    // Record parameters and precalculations on this thread's tape
+                    Number::tape->rewind();
+                    for (Number *p : ws.model->parameters())
+                        p->putOnTape();
+                    ws.simulator = std::make_unique<ScriptSimulator<Number>>(*ws.model, *ws.random);
+                    ws.simulator->initForScripting(prd.eventDates());
+                    ws.scenario = prd.buildScenario<Number>();
+                    if (fuzzyWidth > 0.0)
+                        ws.tree = prd.buildFuzzyEvaluator<Number>(fuzzyWidth);
+                    else if (prd.sharedFlat())
+                        ws.flat = prd.buildFlatEvaluator<Number>();
+                    else
+                        ws.tree = prd.buildEvaluator<Number>();
+                    Number::tape->mark();
+                    ws.initialised = true;
+                }
+
+                // Tasks are popped in queue order so threads mostly skip forward, otherwise restart
+                // from a fresh generator. The model was initialised before the mark and is kept
+                const size_t firstPath = b * batchSize;
+                const size_t numPaths = std::min(batchSize, numSim - firstPath);
+                if (ws.position > firstPath)
+                {
+                    ws.random = random.clone();
+                    ws.random->init(ws.model->dim());
+                    ws.simulator = std::make_unique<ScriptSimulator<Number>>(*ws.model, *ws.random);
+                    ws.position = 0;
+                }
+                ws.random->skipAhead(long(firstPath - ws.position));
+                PathStatistics &stats = batchStats[b];
+                for (size_t i = 0; i < numPaths; ++i)
+                {
+                    Number::tape->rewindToMark();
+                    ws.simulator->nextScenario(*ws.scenario);
+                    const std::vector<Number> *vals;
+                    if (ws.flat)
+                    {
+                        ws.flat->init();
+                        prd.evaluate(*ws.scenario, *ws.flat);
+                        vals = &ws.flat->variables();
+                    }
+                    else
+                    {
+                        ws.tree->init();
+                        prd.evaluate(*ws.scenario, *ws.tree);
+                        vals = &ws.tree->variables();
+                    }
+                    Number result = (*vals)[idx];
+                    result.propagateToMark();
+                    stats.add(*vals);
+                }
+                ws.position = firstPath + numPaths;
+                return true;
+            }));
+        }
+        for (auto &future : futures)
+            pool->activeWait(future);
+        for (auto &future : futures)
+            future.get();
+
+        // Propagate each used tape from its mark to the parameters of its model
+        ScriptRisks results;
+        results.statistics = PathStatistics(nVar);
+        results.parameterLabels = model.parameterLabels();
+        results.risks.resize(results.parameterLabels.size(), 0.0);
+        for (size_t t = 0; t < nThread; ++t)
+        {
+            if (!workspaces[t].initialised)
+                continue;
+            Number::tape = t == 0 ? mainTape : &tapes[t - 1];
+            Number::propagateMarkToStart();
+            const std::vector<Number *> params = workspaces[t].model->parameters();
+            for (size_t j = 0; j < params.size(); ++j)
+                results.risks[j] += params[j]->adjoint();
+        }
+        Number::tape = mainTape;
+
+        // Merged in batch order, whatever thread valued them
+        for (auto &stats : batchStats)
+            results.statistics.merge(stats);
+        results.values = results.statistics.means();
+        for (auto &r : results.risks)
+            r /= double(numSim);
+        mainTape->clear();
+        return results;
+    };
+}
@@ -0,0 +1,137 @@
+#include "product/incremental.h"
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace QuantScript {
+    IncrementalValuation::IncrementalValuation(Product& prd, const PathStore& paths)
+        : myProduct(prd), myPaths(paths), myIndices(paths.indicesOf(prd.eventDates())), myNames(prd.varNames()),
+          myDependencies(prd.varDependencies()) {
+        const size_t nE = myIndices.size();
+        const size_t nVar = myNames.size();
+        mySnapshots.assign(nVar, std::vector<double>(myPaths.numPaths() * (nE + 1)));
+        myValues.assign(nVar, 0.0);
+
+        auto scenario = myProduct.buildScenario<double>();
+        auto evaluator = myProduct.buildEvaluator<double>();
+        std::vector<double>& vars = evaluator->variables();
+        // Rows of one path, written to the columns once the path is done
+        std::vector<double> rows((nE + 1) * nVar);
+        for (size_t p = 0; p < myPaths.numPaths(); ++p) {
+            myPaths.load(p, myIndices, *scenario);
+            evaluator->init();
+            for (size_t e = 0; e < nE; ++e) {
+                std::copy(vars.begin(), vars.end(), rows.begin() + e * nVar);
+                myProduct.evaluateEvent(e, *scenario, *evaluator);
+            };
+            std::copy(vars.begin(), vars.end(), rows.begin() + nE * nVar);
+            for (size_t v = 0; v < nVar; ++v) {
+                double* column = mySnapshots[v].data() + row(p, 0);
+                for (size_t e = 0; e <= nE; ++e) {
+                    column[e] = rows[e * nVar + v];
+                };
+            };
+            for (size_t v = 0; v < nVar; ++v) {
+                myValues[v] += vars[v];
+            };
+        };
+        for (auto& value : myValues) {
+            value /= double(myPaths.numPaths());
+        };
+    };
+
+    void IncrementalValuation::remapVariables() {
+        const std::vector<std::string> names = myProduct.varNames();
+        if (names == myNames) {
+            return;
+        };
+        // Columns move by name, variables new to the script were never written and start at 0
+        std::map<std::string, size_t> oldIndex;
+        for (size_t v = 0; v < myNames.size(); ++v) {
+            oldIndex[myNames[v]] = v;
+        };
+        const size_t numRows = myPaths.numPaths() * (myIndices.size() + 1);
+        std::vector<std::vector<double>> snapshots(names.size());
+        std::vector<double> values(names.size(), 0.0);
+        for (size_t v = 0; v < names.size(); ++v) {
+            const auto it = oldIndex.find(names[v]);
+            if (it != oldIndex.end()) {
+                snapshots[v].swap(mySnapshots[it->second]);
+                values[v] = myValues[it->second];
+            }
+            else {
+                snapshots[v].assign(numRows, 0.0);
+            };
+        };
+        mySnapshots.swap(snapshots);
+        myValues.swap(values);
+        myNames = names;
+    };
+
+    size_t IncrementalValuation::replaceEvent(size_t i, const std::string& script) {
+        // Variables the old event wrote may change too, keep them by name
+        std::set<std::string> oldWrites;
+        for (size_t v : myDependencies.writes(i)) {
+            oldWrites.insert(myNames[v]);
+        };
+        myProduct.replaceEvent(i, script);
+        myProduct.indexVariables();
+        remapVariables();
+        myDependencies = myProduct.varDependencies();
+
+        std::set<size_t> changedVars;
+        for (size_t v = 0; v < myNames.size(); ++v) {
+            if (oldWrites.count(myNames[v])) {
+                changedVars.insert(v);
+            };
+        };
+        const std::vector<size_t> affected = myDependencies.affectedEvents(i, changedVars);
+        for (size_t e : affected) {
+            changedVars.insert(myDependencies.writes(e).begin(), myDependencies.writes(e).end());
+        };
+        const std::vector<size_t> changed(changedVars.begin(), changedVars.end());
+
+        const size_t nE = myIndices.size();
+        const size_t nVar = myNames.size();
+        std::vector<bool> isAffected(nE, false);
+        for (size_t e : affected) {
+            isAffected[e] = true;
+        };
+        auto scenario = myProduct.buildScenario<double>();
+        auto evaluator = myProduct.buildEvaluator<double>();
+        std::vector<double>& vars = evaluator->variables();
+        for (size_t v : changed) {
+            myValues[v] = 0.0;
+        };
+        for (size_t p = 0; p < myPaths.numPaths(); ++p) {
+            myPaths.load(p, myIndices, *scenario);
+            evaluator->init();
+            for (size_t v = 0; v < nVar; ++v) {
+                vars[v] = mySnapshots[v][row(p, i)];
+            };
+            // Affected events also cover the events writing a changed variable, so unaffected
+            // events only write unchanged ones, whose values the snapshot after them holds
+            for (size_t e = i; e < nE; ++e) {
+                const size_t after = row(p, e + 1);
+                if (isAffected[e]) {
+                    myProduct.evaluateEvent(e, *scenario, *evaluator);
+                }
+                else {
+                    for (size_t v : myDependencies.writes(e)) {
+                        vars[v] = mySnapshots[v][after];
+                    };
+                };
+                for (size_t v : changed) {
+                    mySnapshots[v][after] = vars[v];
+                };
+            };
+            for (size_t v : changed) {
+                myValues[v] += vars[v];
+            };
+        };
+        for (size_t v : changed) {
+            myValues[v] /= double(myPaths.numPaths());
+        };
+        return affected.size();
+    };
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "product/product.h"
+#include "models/pathstore.h"
+#include "visitors/vardependencies.h"
+
+#include <string>
+#include <vector>
+
+namespace QuantScript
+{
+    // Valuation of a product on the paths of a PathStore that keeps, per path, the variables
+    // before every event and after the last one. When the script of an event is replaced only
+    // the events the VarDependencies DAG marks as affected are evaluated again, carrying the
+    // variables along from the snapshot before the edited event, and unaffected events only
+    // refresh the variables they write. Snapshots take numPaths * (numEvents + 1) * numVariables
+    // doubles, one column per variable so that new variables are appended without moving the others
+    class IncrementalValuation
+    {
+        Product &myProduct;
+        const PathStore &myPaths;
+        std::vector<size_t> myIndices;
+        std::vector<std::string> myNames;
+        VarDependencies myDependencies;
+        // [variable][path * (numEvents + 1) + boundary], boundary e is before event e
+        std::vector<std::vector<double>> mySnapshots;
+        std::vector<double> myValues;
+
+        size_t row(size_t path, size_t boundary) const
+        {
+            return path * (myIndices.size() + 1) + boundary;
+        };
+        // Move the snapshots to the variables of the re-indexed product, by name
+        void remapVariables();
+
+    public:
+        // Value prd on every path of paths, prd must be indexed and not flattened, its
+        // event dates on the timeline of paths. Both must outlive the valuation
+        IncrementalValuation(Product &prd, const PathStore &paths);
+
+        // Average of every variable, in the order of Product::varNames
+        const std::vector<double> &values() const { return myValues; };
+        const std::vector<std::string> &varNames() const { return myNames; };
+
+        // Replace the script of event i and re-evaluate the affected events, returns the number
+        // of events evaluated per path. Variables new to the script start at 0 on every snapshot
+        size_t replaceEvent(size_t i, const std::string &script);
+    };
+}
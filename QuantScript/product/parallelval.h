@@ -0,0 +1,326 @@
+#pragma once
+#include "product/product.h"
+#include "models/models.h"
+#include "models/pathstore.h"
+#include "product/statistics.h"
+#include "aad/threadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace QuantScript
+{
+    // Paths per task sent to the ThreadPool
+    constexpr size_t SCRIPT_BATCHSIZE = 64;
+
+    // Index of target in the variables of prd, throws if absent
+    inline size_t targetIndex(Product &prd, const std::string &target)
+    {
+        const std::vector<std::string> names = prd.varNames();
+        const auto it = std::find(names.begin(), names.end(), target);
+        if (it == names.end())
+            throw std::runtime_error("Unknown target variable " + target);
+        return it - names.begin();
+    };
+
+    // Paths of a model valued in batches on the ThreadPool (start it first, otherwise the
+    // caller runs every batch), each thread with its own model, scenario and evaluator. Every
+    // batch positions its generator on its first path with skipAhead and batch statistics are
+    // merged in batch order, so results are identical whatever the number of threads.
+    // The generator must support skipAhead, e.g. Mrg32k3aGen
+    class ParallelScriptSimulation
+    {
+        // Per thread workspace, the generator position is tracked to skip from there
+        struct Workspace
+        {
+            std::unique_ptr<Model<double>> model;
+            std::unique_ptr<RandomGen> random;
+            std::unique_ptr<ScriptSimulator<double>> simulator;
+            std::unique_ptr<Scenario<double>> scenario;
+            std::unique_ptr<Evaluator<double>> tree;
+            std::unique_ptr<FlatEvaluator<double>> flat;
+            size_t position = 0;
+        };
+
+        Product &myProduct;
+        std::vector<Workspace> myWorkspaces;
+        std::unique_ptr<RandomGen> myStart;
+
+    public:
+        ParallelScriptSimulation(Product &prd, const Model<double> &model, const RandomGen &random)
+            : myProduct(prd), myWorkspaces(ThreadPool::getInstance()->numThreads() + 1) // +1 for the caller
+        {
+            for (auto &ws : myWorkspaces)
+            {
+                ws.model = model.clone();
+                ws.random = random.clone();
+                ws.simulator = std::make_unique<ScriptSimulator<double>>(*ws.model, *ws.random);
+                ws.simulator->initForScripting(prd.eventDates());
+                // Fail here rather than in a task for generators that cannot skip
+                ws.random->skipAhead(0);
+                ws.scenario = prd.buildScenario<double>();
+                if (prd.sharedFlat())
+                    ws.flat = prd.buildFlatEvaluator<double>();
+                else
+                    ws.tree = prd.buildEvaluator<double>();
+            }
+            myStart = myWorkspaces[0].random->clone();
+        };
+
+        size_t numThreads() const { return myWorkspaces.size(); };
+
+        // Value numPaths paths from firstPath on and merge them into results. Successive calls
+        // over consecutive ranges whose sizes are multiples of batchSize give the same
+        // statistics as a single call over the whole range
+        void simulate(const size_t firstPath, const size_t numPaths, const size_t batchSize, PathStatistics &results)
+        {
+            const size_t nVar = myProduct.varNames().size();
+            const size_t numBatch = (numPaths + batchSize - 1) / batchSize;
+            ThreadPool *pool = ThreadPool::getInstance();
+
+            std::vector<PathStatistics> batchStats(numBatch, PathStatistics(nVar));
+            std::vector<TaskHandle> futures;
+            futures.reserve(numBatch);
+            for (size_t b = 0; b < numBatch; ++b)
+            {
+                futures.push_back(pool->spawnTask([&, b]()
+                {
+                    Workspace &ws = myWorkspaces[ThreadPool::threadNum()];
+                    const size_t batchFirst = firstPath + b * batchSize;
+                    const size_t batchPaths = std::min(batchSize, numPaths - b * batchSize);
+                    // Batches are queued in order so threads mostly skip forward
+                    if (ws.position > batchFirst)
+                    {
+                        ws.random = myStart->clone();
+                        ws.simulator = std::make_unique<ScriptSimulator<double>>(*ws.model, *ws.random);
+                        ws.simulator->initForScripting(myProduct.eventDates());
+                        ws.position = 0;
+                    }
+                    ws.random->skipAhead(long(batchFirst - ws.position));
+                    PathStatistics &stats = batchStats[b];
+                    for (size_t i = 0; i < batchPaths; ++i)
+                    {
+                        ws.simulator->nextScenario(*ws.scenario);
+                        const std::vector<double> *vals;
+                        if (ws.flat)
+                        {
+                            ws.flat->init();
+                            myProduct.evaluate(*ws.scenario, *ws.flat);
+                            vals = &ws.flat->variables();
+                        }
+                        else
+                        {
+                            ws.tree->init();
+                            myProduct.evaluate(*ws.scenario, *ws.tree);
+                            vals = &ws.tree->variables();
+                        }
+                        stats.add(*vals);
+                    }
+                    ws.position = batchFirst + batchPaths;
+                    return true;
+                }));
+            }
+            // Help while waiting, then rethrow any exception of a task
+            for (auto &future : futures)
+                pool->activeWait(future);
+            for (auto &future : futures)
+                future.get();
+
+            for (auto &stats : batchStats)
+                results.merge(stats);
+        };
+    };
+
+    // Price and standard error of every variable of prd over numSim paths, in the order of
+    // Product::varNames, identical whatever the number of threads
+    inline PathStatistics parallelScriptVal(Product &prd, const Model<double> &model, const RandomGen &random,
+                                            const size_t numSim, const size_t batchSize = SCRIPT_BATCHSIZE)
+    {
+        ParallelScriptSimulation simulation(prd, model, random);
+        PathStatistics results(prd.varNames().size());
+        simulation.simulate(0, numSim, batchSize, results);
+        return results;
+    };
+
+    // parallelScriptVal over every path of a PathStore, the event dates of prd must be on its
+    // timeline. Batches read their paths directly, no generator or model is involved, and
+    // results are identical whatever the number of threads
+    inline PathStatistics parallelScriptVal(Product &prd, const PathStore &paths,
+                                            const size_t batchSize = SCRIPT_BATCHSIZE)
+    {
+        const std::vector<size_t> indices = paths.indicesOf(prd.eventDates());
+        const size_t numSim = paths.numPaths();
+        const size_t nVar = prd.varNames().size();
+        const size_t numBatch = (numSim + batchSize - 1) / batchSize;
+
+        ThreadPool *pool = ThreadPool::getInstance();
+        const size_t nThread = pool->numThreads() + 1; // +1 for the caller
+
+        struct Workspace
+        {
+            std::unique_ptr<Scenario<double>> scenario;
+            std::unique_ptr<Evaluator<double>> tree;
+            std::unique_ptr<FlatEvaluator<double>> flat;
+        };
+        std::vector<Workspace> workspaces(nThread);
+        for (auto &ws : workspaces)
+        {
+            ws.scenario = prd.buildScenario<double>();
+            if (prd.sharedFlat())
+                ws.flat = prd.buildFlatEvaluator<double>();
+            else
+                ws.tree = prd.buildEvaluator<double>();
+        }
+
+        std::vector<PathStatistics> batchStats(numBatch, PathStatistics(nVar));
+        std::vector<TaskHandle> futures;
+        futures.reserve(numBatch);
+        for (size_t b = 0; b < numBatch; ++b)
+        {
+            futures.push_back(pool->spawnTask([&, b]()
+            {
+                Workspace &ws = workspaces[ThreadPool::threadNum()];
+                const size_t firstPath = b * batchSize;
+                const size_t lastPath = std::min(firstPath + batchSize, numSim);
+                PathStatistics &stats = batchStats[b];
+                for (size_t p = firstPath; p < lastPath; ++p)
+                {
+                    paths.load(p, indices, *ws.scenario);
+                    const std::vector<double> *vals;
+                    if (ws.flat)
+                    {
+                        ws.flat->init();
+                        prd.evaluate(*ws.scenario, *ws.flat);
+                        vals = &ws.flat->variables();
+                    }
+                    else
+                    {
+                        ws.tree->init();
+                        prd.evaluate(*ws.scenario, *ws.tree);
+                        vals = &ws.tree->variables();
+                    }
+                    stats.add(*vals);
+                }
+                return true;
+            }));
+        }
+        for (auto &future : futures)
+            pool->activeWait(future);
+        for (auto &future : futures)
+            future.get();
+
+        PathStatistics results(nVar);
+        for (auto &stats : batchStats)
+            results.merge(stats);
+        return results;
+    };
+
+    // Criterion that ended a convergentScriptVal run
+    enum class ConvergenceStop
+    {
+        // Every target reached its standard error tolerance
+        Tolerance,
+        Deadline,
+        MaxPaths
+    };
+
+    // Settings of convergentScriptVal
+    struct ConvergenceSettings
+    {
+        // Variables whose standard errors are targeted, every variable when empty
+        std::vector<std::string> targets;
+        // A target converged when its standard error is within the larger of absoluteTolerance
+        // and relativeTolerance times its price. Both 0: only the deadline or maxPaths stop the run
+        double absoluteTolerance = 0.0;
+        double relativeTolerance = 0.0;
+        // Wall-clock budget in seconds, checked between rounds of paths
+        double deadline = std::numeric_limits<double>::infinity();
+        // Paths of the first round, before any standard error is trusted
+        size_t minPaths = 1000;
+        size_t maxPaths = 10000000;
+    };
+
+    // Result of convergentScriptVal
+    struct ConvergenceResult
+    {
+        // Price, standard error and path count of every variable
+        PathStatistics statistics;
+        ConvergenceStop stop = ConvergenceStop::MaxPaths;
+        double seconds = 0.0;
+    };
+
+    // parallelScriptVal simulating rounds of paths until the standard errors of the targets
+    // reach their tolerance, the deadline expires or maxPaths are simulated. Each round is
+    // sized for the worst target from its standard error, which falls as one over the square
+    // root of the path count, at most doubling the paths so far and limited to the paths the
+    // remaining time allows at the speed so far. Rounds are whole batches, so a run stopped
+    // on tolerance or maxPaths is identical to parallelScriptVal over the same number of paths
+    inline ConvergenceResult convergentScriptVal(Product &prd, const Model<double> &model, const RandomGen &random,
+                                                 const ConvergenceSettings &settings = ConvergenceSettings(),
+                                                 const size_t batchSize = SCRIPT_BATCHSIZE)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<size_t> targets;
+        for (const std::string &target : settings.targets)
+            targets.push_back(targetIndex(prd, target));
+        if (targets.empty())
+            for (size_t v = 0; v < prd.varNames().size(); ++v)
+                targets.push_back(v);
+        const bool hasTolerance = settings.absoluteTolerance > 0.0 || settings.relativeTolerance > 0.0;
+
+        ParallelScriptSimulation simulation(prd, model, random);
+        // At least a batch per thread in a round
+        const size_t minRound = batchSize * simulation.numThreads();
+
+        ConvergenceResult result;
+        result.statistics = PathStatistics(prd.varNames().size());
+        PathStatistics &stats = result.statistics;
+        size_t round = std::max(settings.minPaths, size_t(2));
+        while (true)
+        {
+            round = std::min((round + batchSize - 1) / batchSize * batchSize, settings.maxPaths - stats.count());
+            simulation.simulate(stats.count(), round, batchSize, stats);
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            const double n = double(stats.count());
+
+            // Paths the worst target needs, infinite without a tolerance
+            double needed = hasTolerance ? 0.0 : std::numeric_limits<double>::infinity();
+            for (size_t v : targets)
+            {
+                const double tolerance = std::max(settings.absoluteTolerance, settings.relativeTolerance * std::fabs(stats.mean(v)));
+                const double error = stats.standardError(v);
+                if (error <= tolerance)
+                    continue;
+                needed = std::max(needed, tolerance > 0.0 ? n * (error / tolerance) * (error / tolerance)
+                                                          : std::numeric_limits<double>::infinity());
+            }
+            if (hasTolerance && needed == 0.0)
+            {
+                result.stop = ConvergenceStop::Tolerance;
+                break;
+            }
+            if (stats.count() >= settings.maxPaths)
+            {
+                result.stop = ConvergenceStop::MaxPaths;
+                break;
+            }
+            if (result.seconds >= settings.deadline)
+            {
+                result.stop = ConvergenceStop::Deadline;
+                break;
+            }
+
+            double next = std::min(needed - n, n);
+            if (std::isfinite(settings.deadline))
+                next = std::min(next, n / result.seconds * (settings.deadline - result.seconds));
+            round = std::max(size_t(next), minRound);
+        }
+        return result;
+    };
+}
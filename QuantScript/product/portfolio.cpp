@@ -0,0 +1,40 @@
+#include "product/portfolio.h"
+#include <algorithm>
+
+namespace QuantScript {
+    size_t Portfolio::add(Product&& product) {
+        myProducts.push_back(std::move(product));
+        myDirty = true;
+        return myProducts.size() - 1;
+    };
+
+    void Portfolio::buildTimeline() {
+        if (!myDirty) return;
+        myTimeline.clear();
+        for (auto& p : myProducts) {
+            myTimeline.insert(myTimeline.end(), p.eventDates().begin(), p.eventDates().end());
+        };
+        std::sort(myTimeline.begin(), myTimeline.end());
+        myTimeline.erase(std::unique(myTimeline.begin(), myTimeline.end()), myTimeline.end());
+
+        myEventIndices.resize(myProducts.size());
+        for (size_t k = 0; k < myProducts.size(); ++k) {
+            const auto& dates = myProducts[k].eventDates();
+            myEventIndices[k].resize(dates.size());
+            for (size_t e = 0; e < dates.size(); ++e) {
+                myEventIndices[k][e] = std::lower_bound(myTimeline.begin(), myTimeline.end(), dates[e]) - myTimeline.begin();
+            };
+        };
+        myDirty = false;
+    };
+
+    const std::vector<Date>& Portfolio::timeline() {
+        buildTimeline();
+        return myTimeline;
+    };
+
+    const std::vector<size_t>& Portfolio::eventIndices(size_t i) {
+        buildTimeline();
+        return myEventIndices[i];
+    };
+}
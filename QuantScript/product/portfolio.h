@@ -0,0 +1,131 @@
+#pragma once
+#include "product/product.h"
+#include "models/models.h"
+#include "product/statistics.h"
+
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace QuantScript
+{
+    // Monte-Carlo averages of a Portfolio valuation
+    template <class T>
+    struct PortfolioResults
+    {
+        // Per trade, the average of each variable in the order of Product::varNames
+        std::vector<std::vector<T>> trades;
+        // Per trade, the means and standard errors the averages are taken from
+        std::vector<PathStatistics> statistics;
+        // Sum of the trade averages by variable name
+        std::map<std::string, T> aggregate;
+    };
+
+    // Book of products valued on one shared simulation. Event dates of all trades are
+    // merged into one timeline, each path is simulated once on it and every trade
+    // reads its own events from the path by index. A trade gets the values of a valuation
+    // on its own over the same paths, e.g. from a PathStore on the timeline, not those of a
+    // simulation on its own event dates, which consumes the random numbers differently.
+    class Portfolio
+    {
+        std::vector<Product> myProducts;
+        std::vector<Date> myTimeline;
+        // Per trade, the timeline index of each of its events
+        std::vector<std::vector<size_t>> myEventIndices;
+        bool myDirty = false;
+
+        void buildTimeline();
+
+    public:
+        // Add a trade and return its index. Products must be indexed, or flattened
+        // (e.g. loaded through the ProductCache or a ProductArchive)
+        size_t add(Product &&product);
+        size_t size() const { return myProducts.size(); };
+        // Read only, a change to the event dates would not rebuild the timeline
+        const Product &product(size_t i) const { return myProducts[i]; };
+        // Sorted union of the event dates of all trades
+        const std::vector<Date> &timeline();
+        // Timeline index of each event of trade i
+        const std::vector<size_t> &eventIndices(size_t i);
+
+        // Value all trades on numSim paths of model, the model is initialised on the timeline
+        template <class T>
+        PortfolioResults<T> value(Model<T> &model, RandomGen &random, const size_t numSim)
+        {
+            if (myProducts.empty())
+                throw std::runtime_error("Cannot value an empty portfolio");
+            buildTimeline();
+
+            // Per trade scenario on its own events, and its evaluator
+            struct Trade
+            {
+                Scenario<T> scenario;
+                std::unique_ptr<Evaluator<T>> tree;
+                std::unique_ptr<FlatEvaluator<T>> flat;
+            };
+            std::vector<Trade> trades(myProducts.size());
+            PortfolioResults<T> results;
+            results.trades.resize(myProducts.size());
+            results.statistics.resize(myProducts.size());
+            for (size_t k = 0; k < myProducts.size(); ++k)
+            {
+                trades[k].scenario = Scenario<T>(myEventIndices[k].size());
+                if (myProducts[k].sharedFlat())
+                    trades[k].flat = myProducts[k].buildFlatEvaluator<T>();
+                else
+                    trades[k].tree = myProducts[k].buildEvaluator<T>();
+                results.statistics[k] = PathStatistics(myProducts[k].varNames().size());
+            }
+
+            ScriptSimulator<T> simulator(model, random);
+            simulator.initForScripting(myTimeline);
+            Scenario<T> path(myTimeline.size());
+            for (size_t i = 0; i < numSim; ++i)
+            {
+                simulator.nextScenario(path);
+                for (size_t k = 0; k < myProducts.size(); ++k)
+                {
+                    Trade &trade = trades[k];
+                    const std::vector<size_t> &indices = myEventIndices[k];
+                    for (size_t e = 0; e < indices.size(); ++e)
+                    {
+                        trade.scenario.spot(e) = path.spot(indices[e]);
+                        trade.scenario.numeraire(e) = path.numeraire(indices[e]);
+                    }
+                    const std::vector<T> *vals;
+                    if (trade.flat)
+                    {
+                        trade.flat->init();
+                        myProducts[k].evaluate(trade.scenario, *trade.flat);
+                        vals = &trade.flat->variables();
+                    }
+                    else
+                    {
+                        trade.tree->init();
+                        myProducts[k].evaluate(trade.scenario, *trade.tree);
+                        vals = &trade.tree->variables();
+                    }
+                    results.statistics[k].add(*vals);
+                }
+            }
+
+            for (size_t k = 0; k < myProducts.size(); ++k)
+            {
+                const std::vector<double> &means = results.statistics[k].means();
+                results.trades[k].assign(means.begin(), means.end());
+                const std::vector<std::string> names = myProducts[k].varNames();
+                for (size_t v = 0; v < names.size(); ++v)
+                {
+                    auto it = results.aggregate.find(names[v]);
+                    if (it == results.aggregate.end())
+                        results.aggregate.emplace(names[v], results.trades[k][v]);
+                    else
+                        it->second += results.trades[k][v];
+                }
+            }
+            return results;
+        };
+    };
+}
@@ -1,8 +1,19 @@
 #include "product/product.h"
 #include "parser/parser.h"
+#include "product/productcache.h"
+#include "visitors/codegen.h"
+#include "visitors/compiler.h"
+#include "visitors/constfolder.h"
+#include "visitors/cseliminator.h"
+#include "visitors/deadcode.h"
+#include "visitors/ifprocessor.h"
+#include <algorithm>
 
 namespace QuantScript {
-    const std::vector<Date>& Product::eventDates() {
+    Product::Product(std::vector<Date> eventDates, std::shared_ptr<const FlatAst> flat)
+        : myEventDates(std::move(eventDates)), myVariables(flat->varNames()), myFlat(std::move(flat)) {};
+
+    const std::vector<Date>& Product::eventDates() const {
         return myEventDates; 
     };
     void Product::visit(Visitor& visitor) {
@@ -17,7 +28,123 @@ namespace QuantScript {
         visit(indexer);
         myVariables = indexer.getVarNames();
     };
+    size_t Product::foldConstants() {
+        ConstFolder folder;
+        for (auto& e : myEvents) {
+            for (auto& s : e) {
+                folder.fold(s);
+            };
+        };
+        return folder.removed();
+    };
+    size_t Product::eliminateCommonSubexpressions() {
+        CseEliminator eliminator;
+        return eliminator.eliminate(myEvents);
+    };
+    size_t Product::pruneForOutputs(const std::vector<std::string>& outputs) {
+        DeadCodeEliminator eliminator(outputs);
+        return eliminator.eliminate(myEvents);
+    };
     std::vector<std::string> Product::varNames() {
         return myVariables;
     };
+    void Product::compile() {
+        if (myFlat) {
+            throw std::runtime_error("Cannot compile a flattened product");
+        };
+        Compiler compiler(myVariables.size());
+        for (auto& e : myEvents) {
+            compiler.compileEvent(e);
+        };
+        myProgram = compiler.program();
+    };
+    const Program& Product::program() const {
+        return myProgram;
+    };
+    void Product::checkCompiled() const {
+        if (myProgram.eventStart.empty()) {
+            throw std::runtime_error(myFlat ? "Flattening dropped the compiled program" : "The product is not compiled");
+        };
+    };
+    void Product::flatten() {
+        myFlat = std::make_shared<const FlatAst>(myEvents, myVariables);
+        // Drop the per-node allocations, and the program which reads SOLVE() values from them
+        std::vector<Event>().swap(myEvents);
+        myProgram = Program();
+    };
+    void Product::loadScripts(const std::vector<std::string>& scripts, const MacroTable& macros) {
+        // Normalized text: expanded tokens, upper-cased, one line per event
+        std::string key;
+        for (auto& script : scripts) {
+            for (auto& tok : macros.expandTokens(script)) {
+                const size_t start = key.size();
+                key.append(tok.text.begin(), tok.text.end());
+                std::transform(key.begin() + start, key.end(), key.begin() + start, ::toupper);
+                key += ' ';
+            };
+            key += '\n';
+        };
+        myFlat = ProductCache::getInstance().get(key, [&]() {
+            std::vector<Event> events;
+            for (auto& script : scripts) {
+                events.push_back(parse(script, macros));
+            };
+            VarIndexer indexer;
+            for (auto& e : events) {
+                for (auto& s : e) {
+                    s->acceptVisitor(indexer);
+                };
+            };
+            return std::make_shared<const FlatAst>(events, indexer.getVarNames());
+        });
+        myVariables = myFlat->varNames();
+    };
+    const FlatAst& Product::flat() const {
+        return *myFlat;
+    };
+    void Product::processIfs() {
+        IfProcessor processor;
+        visit(processor);
+    };
+    StackDepth Product::stackDepth() const {
+        StackDepth depth;
+        for (auto& e : myEvents) {
+            for (auto& s : e) {
+                s->acceptVisitor(depth);
+            };
+        };
+        return depth;
+    };
+    VarDependencies Product::varDependencies() const {
+        VarDependencies dependencies;
+        for (auto& e : myEvents) {
+            dependencies.addEvent(e);
+        };
+        return dependencies;
+    };
+    void Product::replaceEvent(size_t i, const std::string& script) {
+        if (myFlat) {
+            throw std::runtime_error("Cannot replace an event of a flattened product");
+        };
+        myEvents.at(i) = parse(script);
+    };
+    std::string Product::generateSource() const {
+        CodeGenerator generator(myVariables);
+        for (auto& e : myEvents) {
+            generator.generateEvent(e);
+        };
+        return generator.source();
+    };
+    std::unique_ptr<NativeEvaluator> Product::buildNativeEvaluator(const std::string& cacheDir) const {
+        try {
+            auto module = NativeModule::load(generateSource(), cacheDir);
+            return std::unique_ptr<NativeEvaluator>(new NativeEvaluator(module));
+        }
+        catch (const script_error&) {
+            return nullptr;
+        }
+        catch (const native_build_error&) {
+            return nullptr;
+        };
+    };
 }
\ No newline at end of file
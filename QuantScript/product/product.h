@@ -2,9 +2,19 @@
 #include "nodes/nodes.h"
 #include "visitors/varindexer.h"
 #include "visitors/evaluator.h"
+#include "visitors/fuzzyevaluator.h"
+#include "visitors/stackdepth.h"
+#include "visitors/vardependencies.h"
+#include "visitors/flatevaluator.h"
+#include "nodes/flatast.h"
 #include "visitors/solverevaluator.h"
+#include "bytecode/interpreter.h"
+#include "bytecode/batchinterpreter.h"
+#include "bytecode/native.h"
 #include "models/models.h"
 #include "parser/parser.h"
+#include "parser/macros.h"
+#include "others/allocguard.h"
 
 #include <cstdint>
 #include <functional>
@@ -12,21 +22,61 @@
 
 namespace QuantScript
 {
-    class ObjFunc;
-
     class Product
     {
         std::vector<Date> myEventDates;
         std::vector<Event> myEvents;
         std::vector<std::string> myVariables;
+        Program myProgram;
+        std::shared_ptr<const FlatAst> myFlat;
+
+        void loadScripts(const std::vector<std::string> &scripts, const MacroTable &macros);
+        // Throws std::runtime_error without a program to run
+        void checkCompiled() const;
 
     public:
-        const std::vector<Date> &eventDates();
+        Product() {};
+        // Product over already parsed and indexed events, e.g. from a ProductArchive.
+        // Evaluate with a FlatEvaluator
+        Product(std::vector<Date> eventDates, std::shared_ptr<const FlatAst> flat);
+
+        const std::vector<Date> &eventDates() const;
         void visit(Visitor &visitor);
         void indexVariables();
+        // Fold constant subtrees and trivial identities, returns the number of nodes removed
+        size_t foldConstants();
+        // Compute repeated subexpressions once into temporaries, must run before indexVariables.
+        // Returns the number of subexpressions replaced
+        size_t eliminateCommonSubexpressions();
+        // Remove statements that cannot affect the given output variables, must run before indexVariables.
+        // Returns the number of statements removed
+        size_t pruneForOutputs(const std::vector<std::string> &outputs);
+        // Compile events to bytecode, variables must be indexed first.
+        // Throws std::runtime_error if the product is flattened
+        void compile();
+        const Program &program() const;
+        // Move the events into a contiguous FlatAst and release the pointer tree and the
+        // bytecode compiled from it, variables must be indexed and tree passes run before
+        void flatten();
+        const FlatAst &flat() const;
+        // Shared FlatAst, null before flatten
+        const std::shared_ptr<const FlatAst> &sharedFlat() const { return myFlat; };
+        // Evaluator stack depths over all events
+        StackDepth stackDepth() const;
+        // Variables read and written by each event, variables must be indexed
+        VarDependencies varDependencies() const;
+        // Parse script in place of event i, index the variables again after.
+        // Throws std::runtime_error if the product is flattened
+        void replaceEvent(size_t i, const std::string &script);
+        // C++ source evaluating the events, variables must be indexed first
+        std::string generateSource() const;
         template <class T>
         void evaluate(const Scenario<T> &scenario, Evaluator<T> &evaluator)
         {
+#ifdef QUANTSCRIPT_CHECK_ALLOCATIONS
+            // The first evaluation may warm up the AAD tape
+            AllocationGuard guard(evaluator.warmedUp());
+#endif
             evaluator.setScenario(&scenario);
             for (size_t i = 0; i < myEvents.size(); i++)
             {
@@ -37,6 +87,36 @@ namespace QuantScript
                 };
             };
         };
+        // Evaluate event i alone from the current variables of evaluator
+        template <class T>
+        void evaluateEvent(size_t i, const Scenario<T> &scenario, Evaluator<T> &evaluator)
+        {
+            evaluator.setScenario(&scenario);
+            evaluator.setCurrentEvent(i);
+            for (auto &statement : myEvents[i])
+            {
+                evaluator.visit(statement);
+            };
+        };
+        template <class T>
+        void evaluate(const Scenario<T> &scenario, BytecodeEvaluator<T> &evaluator)
+        {
+            evaluator.evaluate(scenario);
+        };
+        template <size_t N>
+        void evaluate(const ScenarioBatch<N> &batch, BatchEvaluator<N> &evaluator)
+        {
+            evaluator.evaluate(batch);
+        };
+        template <class T>
+        void evaluate(const Scenario<T> &scenario, FlatEvaluator<T> &evaluator)
+        {
+            evaluator.evaluate(scenario);
+        };
+        void evaluate(const Scenario<double> &scenario, NativeEvaluator &evaluator)
+        {
+            evaluator.evaluate(scenario);
+        };
 
         // Return variable names
         std::vector<std::string> varNames();
@@ -44,8 +124,49 @@ namespace QuantScript
         template <class T>
         std::unique_ptr<Evaluator<T>> buildEvaluator()
         {
-            // Move
-            return std::unique_ptr<Evaluator<T>>(new Evaluator<T>(myVariables.size()));
+            const StackDepth depth = stackDepth();
+            return std::unique_ptr<Evaluator<T>>(new Evaluator<T>(myVariables.size(), depth.maxDepth(), depth.maxBoolDepth()));
+        };
+        // Record in each IF the variables its branches assign, variables must be indexed.
+        // Required before building a FuzzyEvaluator
+        void processIfs();
+        // Fuzzy evaluator factory, conditions are smoothed over a band of width eps, IFs must be processed
+        template <class T>
+        std::unique_ptr<FuzzyEvaluator<T>> buildFuzzyEvaluator(double eps)
+        {
+            const StackDepth depth = stackDepth();
+            return std::unique_ptr<FuzzyEvaluator<T>>(new FuzzyEvaluator<T>(myVariables.size(), depth.maxDepth(), depth.maxBoolDepth(),
+                                                                           depth.maxFuzzyStore(), eps));
+        };
+        // Bytecode evaluator factory, the product must be compiled and not flattened since
+        template <class T>
+        std::unique_ptr<BytecodeEvaluator<T>> buildBytecodeEvaluator()
+        {
+            checkCompiled();
+            return std::unique_ptr<BytecodeEvaluator<T>>(new BytecodeEvaluator<T>(myProgram));
+        };
+        // Flat evaluator factory, the product must be flattened
+        template <class T>
+        std::unique_ptr<FlatEvaluator<T>> buildFlatEvaluator()
+        {
+            return std::unique_ptr<FlatEvaluator<T>>(new FlatEvaluator<T>(*myFlat));
+        };
+        // Batch evaluator factory, N paths per pass, the product must be compiled and not flattened since
+        template <size_t N>
+        std::unique_ptr<BatchEvaluator<N>> buildBatchEvaluator()
+        {
+            checkCompiled();
+            return std::unique_ptr<BatchEvaluator<N>>(new BatchEvaluator<N>(myProgram));
+        };
+        // Native evaluator factory, compiles the generated source into cacheDir or loads it from there.
+        // Returns nullptr when the code generator does not support the script or the compiler rejects it,
+        // evaluate with the product itself in that case. Other failures, e.g. an unwritable cacheDir, throw
+        std::unique_ptr<NativeEvaluator> buildNativeEvaluator(const std::string &cacheDir) const;
+        // Scenario batch factory
+        template <size_t N>
+        std::unique_ptr<ScenarioBatch<N>> buildScenarioBatch()
+        {
+            return std::unique_ptr<ScenarioBatch<N>>(new ScenarioBatch<N>(myEventDates.size()));
         };
         // Scenario factory
         template <class T>
@@ -74,24 +195,29 @@ namespace QuantScript
                 myEvents.push_back(parse(evtIt->second));
             };
         };
+        // Parsed and indexed events through the process-wide ProductCache, products with
+        // the same script share one FlatAst. Evaluate with a FlatEvaluator
+        template <class EventIt>
+        void loadEvents(EventIt begin, EventIt end, const MacroTable &macros = MacroTable())
+        {
+            std::vector<std::string> scripts;
+            for (EventIt evtIt = begin; evtIt != end; ++evtIt)
+            {
+                myEventDates.push_back(evtIt->first);
+                scripts.push_back(evtIt->second);
+            };
+            loadScripts(scripts, macros);
+        };
+        // Event Parser with macro expansion, the table is compiled once and shared across products
+        template <class EventIt>
+        void parseEvents(EventIt begin, EventIt end, const MacroTable &macros)
+        {
+            for (EventIt evtIt = begin; evtIt != end; ++evtIt)
+            {
+                myEventDates.push_back(evtIt->first);
+                myEvents.push_back(parse(evtIt->second, macros));
+            };
+        };
         ;
     };
-
-    // Aux class for solver method
-    class ObjFunc
-    {
-        Product *myProduct;
-
-    public:
-        ObjFunc(Product *prod) : myProduct(prod) {};
-        template <class T>
-        double operator()(T const &x, const Scenario<T> &scenario, Evaluator<T> &evaluator, SolverEvaluator<T> &solver)
-        {
-            solver.update(x);
-            myProduct->evaluate(scenario, evaluator);
-            std::vector<T> varValues = evaluator.varVals();
-            evaluator.init();
-            return std::pow(varValues[solver.getTargetIndex()] - solver.getTargetValue(), 2);
-        }
-    };
 }
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include "product/productarchive.h"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+namespace QuantScript
+{
+    namespace
+    {
+        // Layout: header, AST offsets, product entries, AST records, date blocks.
+        // Every block starts on an 8-byte boundary so mapped data can be read in place.
+        constexpr char ARCHIVE_MAGIC[4] = {'Q', 'S', 'P', 'A'};
+        constexpr uint32_t ENDIAN_TAG = 0x01020304u;
+
+        struct ArchiveHeader
+        {
+            char magic[4];
+            uint32_t version;
+            uint32_t endianTag;
+            uint32_t nodeSize;
+            uint64_t numAsts;
+            uint64_t numProducts;
+        };
+
+        struct ProductEntry
+        {
+            uint64_t ast;
+            uint64_t dates;
+        };
+
+        // Followed by EventRange[numEvents], FlatNode[numNodes], double[numConstants]
+        // and numVariables names, each a uint32 length and its characters padded to 4 bytes
+        struct AstRecord
+        {
+            uint32_t numNodes;
+            uint32_t numConstants;
+            uint32_t numEvents;
+            uint32_t numVariables;
+            uint32_t numSolvers;
+            uint32_t reserved;
+        };
+
+        static_assert(sizeof(FlatNode) == 16 && std::is_trivially_copyable_v<FlatNode>);
+        static_assert(sizeof(FlatAst::EventRange) == 8 && std::is_trivially_copyable_v<FlatAst::EventRange>);
+
+        void append(std::string &buffer, const void *data, size_t size)
+        {
+            buffer.append(static_cast<const char *>(data), size);
+        };
+
+        void pad(std::string &buffer)
+        {
+            buffer.resize((buffer.size() + 7) & ~size_t(7), '\0');
+        };
+
+        void appendAst(std::string &buffer, const FlatAst &ast)
+        {
+            const AstRecord record = {static_cast<uint32_t>(ast.nodes().size()), static_cast<uint32_t>(ast.constants().size()),
+                                      static_cast<uint32_t>(ast.numEvents()), static_cast<uint32_t>(ast.numVariables()),
+                                      ast.numSolvers(), 0};
+            append(buffer, &record, sizeof(record));
+            append(buffer, ast.events().data(), ast.events().size_bytes());
+            // Field by field so the padding after kind is written as zeros
+            for (const FlatNode &n : ast.nodes())
+            {
+                char bytes[sizeof(FlatNode)] = {};
+                std::memcpy(bytes + offsetof(FlatNode, kind), &n.kind, sizeof(n.kind));
+                std::memcpy(bytes + offsetof(FlatNode, first), &n.first, sizeof(n.first));
+                std::memcpy(bytes + offsetof(FlatNode, count), &n.count, sizeof(n.count));
+                std::memcpy(bytes + offsetof(FlatNode, data), &n.data, sizeof(n.data));
+                append(buffer, bytes, sizeof(bytes));
+            }
+            append(buffer, ast.constants().data(), ast.constants().size_bytes());
+            for (const std::string &name : ast.varNames())
+            {
+                const uint32_t length = static_cast<uint32_t>(name.size());
+                append(buffer, &length, sizeof(length));
+                append(buffer, name.data(), name.size());
+                buffer.resize((buffer.size() + alignof(uint32_t) - 1) & ~(alignof(uint32_t) - 1), '\0');
+            }
+            pad(buffer);
+        };
+
+        // Roles a node can take in the evaluator: a statement run, a condition tested or a value computed
+        bool isStatement(NodeKind kind)
+        {
+            return kind == NodeKind::Assign || kind == NodeKind::Pays || kind == NodeKind::If;
+        };
+        bool isCondition(NodeKind kind)
+        {
+            return kind >= NodeKind::Equal && kind <= NodeKind::Or;
+        };
+        bool isValue(NodeKind kind)
+        {
+            return kind <= NodeKind::Min || kind == NodeKind::Spot || kind == NodeKind::Const ||
+                   kind == NodeKind::Var || kind == NodeKind::Solver;
+        };
+
+        // Whether children first to first + count - 1, bounds checked, all satisfy role
+        bool childrenAre(const FlatNode *nodes, const FlatNode &n, uint32_t from, bool (*role)(NodeKind))
+        {
+            for (uint32_t c = from; c < n.count; ++c)
+                if (!role(nodes[n.first + c].kind))
+                    return false;
+            return true;
+        };
+
+        // Whether node i has the children its kind is evaluated with, in the role of their
+        // position. Bounds are checked first
+        bool validChildren(const FlatNode *nodes, uint32_t i)
+        {
+            const FlatNode &n = nodes[i];
+            // Children follow their parent, so no walk can cycle
+            if (n.count > 0 && n.first <= i)
+                return false;
+            switch (n.kind)
+            {
+            case NodeKind::Uplus:
+            case NodeKind::Uminus:
+            case NodeKind::Log:
+            case NodeKind::Sqrt:
+                return n.count == 1 && childrenAre(nodes, n, 0, isValue);
+            case NodeKind::Max:
+            case NodeKind::Min:
+                return n.count >= 1 && childrenAre(nodes, n, 0, isValue);
+            case NodeKind::Assign:
+            case NodeKind::Pays:
+                // The evaluator writes to the variable of the first child
+                return n.count == 2 && nodes[n.first].kind == NodeKind::Var && isValue(nodes[n.first + 1].kind);
+            case NodeKind::If:
+                return n.count >= 1 && (n.data == FlatAst::NO_ELSE || (n.data >= 1 && n.data <= n.count)) &&
+                       isCondition(nodes[n.first].kind) && childrenAre(nodes, n, 1, isStatement);
+            case NodeKind::And:
+            case NodeKind::Or:
+                return n.count == 2 && childrenAre(nodes, n, 0, isCondition);
+            case NodeKind::Spot:
+            case NodeKind::Const:
+            case NodeKind::Var:
+            case NodeKind::Solver:
+                return n.count == 0;
+            default:
+                // Binary operators and comparisons
+                return n.count == 2 && childrenAre(nodes, n, 0, isValue);
+            }
+        };
+
+        // Bounds-checked cursor over the mapped file
+        class Reader
+        {
+            const char *myData;
+            size_t mySize;
+
+        public:
+            size_t pos;
+
+            Reader(const char *data, size_t size, size_t start) : myData(data), mySize(size), pos(start) {};
+
+            template <class T>
+            const T *take(size_t count)
+            {
+                if (count > (mySize - pos) / sizeof(T))
+                    throw std::runtime_error("Truncated product archive");
+                const T *p = reinterpret_cast<const T *>(myData + pos);
+                pos += count * sizeof(T);
+                return p;
+            };
+        };
+
+        std::shared_ptr<const FlatAst> readAst(const std::shared_ptr<const MappedFile> &file, uint64_t offset)
+        {
+            if (offset % 8 != 0 || offset > file->size())
+                throw std::runtime_error("Corrupt product archive");
+            Reader reader(file->data(), file->size(), offset);
+            const AstRecord &record = *reader.take<AstRecord>(1);
+            const FlatAst::EventRange *events = reader.take<FlatAst::EventRange>(record.numEvents);
+            const FlatNode *nodes = reader.take<FlatNode>(record.numNodes);
+            const double *constants = reader.take<double>(record.numConstants);
+            std::vector<std::string> names(record.numVariables);
+            for (auto &name : names)
+            {
+                const uint32_t length = *reader.take<uint32_t>(1);
+                const char *chars = reader.take<char>(length);
+                name.assign(chars, length);
+                // Each name is padded to the next uint32
+                reader.pos = (reader.pos + alignof(uint32_t) - 1) & ~(alignof(uint32_t) - 1);
+            }
+
+            // Links are trusted by the evaluator, reject anything pointing outside the record
+            for (uint32_t e = 0; e < record.numEvents; ++e)
+            {
+                if (events[e].first > record.numNodes || events[e].count > record.numNodes - events[e].first)
+                    throw std::runtime_error("Corrupt product archive");
+                for (uint32_t k = 0; k < events[e].count; ++k)
+                    if (!isStatement(nodes[events[e].first + k].kind))
+                        throw std::runtime_error("Corrupt product archive");
+            }
+            for (uint32_t i = 0; i < record.numNodes; ++i)
+            {
+                const FlatNode &n = nodes[i];
+                if (n.first > record.numNodes || n.count > record.numNodes - n.first ||
+                    (n.kind == NodeKind::Const && n.data >= record.numConstants) ||
+                    (n.kind == NodeKind::Var && n.data >= record.numVariables) ||
+                    (n.kind == NodeKind::Solver && n.data >= record.numSolvers) ||
+                    n.kind > NodeKind::Solver)
+                    throw std::runtime_error("Corrupt product archive");
+            }
+            for (uint32_t i = 0; i < record.numNodes; ++i)
+                if (!validChildren(nodes, i))
+                    throw std::runtime_error("Corrupt product archive");
+
+            return std::make_shared<const FlatAst>(std::span<const FlatNode>(nodes, record.numNodes),
+                                                   std::span<const double>(constants, record.numConstants),
+                                                   std::span<const FlatAst::EventRange>(events, record.numEvents),
+                                                   std::move(names), record.numSolvers, file);
+        };
+    }
+
+    void ProductArchive::write(const std::string &path, const std::vector<const Product *> &products)
+    {
+        std::vector<const FlatAst *> asts;
+        std::unordered_map<const FlatAst *, uint64_t> astIndex;
+        std::vector<uint64_t> productAst;
+        for (const Product *p : products)
+        {
+            if (!p->sharedFlat())
+                throw std::runtime_error("Only flattened products can be archived");
+            auto [it, inserted] = astIndex.emplace(p->sharedFlat().get(), asts.size());
+            if (inserted)
+                asts.push_back(it->first);
+            productAst.push_back(it->second);
+        }
+
+        ArchiveHeader header = {};
+        std::memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+        header.version = PRODUCT_ARCHIVE_VERSION;
+        header.endianTag = ENDIAN_TAG;
+        header.nodeSize = sizeof(FlatNode);
+        header.numAsts = asts.size();
+        header.numProducts = products.size();
+
+        // Tables are patched once the record offsets are known
+        std::string buffer;
+        append(buffer, &header, sizeof(header));
+        const size_t astTable = buffer.size();
+        buffer.resize(buffer.size() + asts.size() * sizeof(uint64_t));
+        const size_t productTable = buffer.size();
+        buffer.resize(buffer.size() + products.size() * sizeof(ProductEntry));
+
+        std::vector<uint64_t> astOffsets;
+        for (const FlatAst *ast : asts)
+        {
+            astOffsets.push_back(buffer.size());
+            appendAst(buffer, *ast);
+        }
+        std::vector<ProductEntry> entries;
+        for (size_t i = 0; i < products.size(); ++i)
+        {
+            entries.push_back({productAst[i], buffer.size()});
+            const std::vector<Date> &dates = products[i]->eventDates();
+            if (dates.size() != asts[productAst[i]]->numEvents())
+                throw std::runtime_error("Event dates do not match the events of the product");
+            for (const Date &d : dates)
+            {
+                const int32_t serial = static_cast<int32_t>(d.serialNumber());
+                append(buffer, &serial, sizeof(serial));
+            }
+            pad(buffer);
+        }
+        std::memcpy(&buffer[astTable], astOffsets.data(), astOffsets.size() * sizeof(uint64_t));
+        std::memcpy(&buffer[productTable], entries.data(), entries.size() * sizeof(ProductEntry));
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        if (!out)
+            throw std::runtime_error("Cannot write " + path);
+    };
+
+    ProductArchive::ProductArchive(const std::string &path) : myFile(std::make_shared<const MappedFile>(path))
+    {
+        Reader reader(myFile->data(), myFile->size(), 0);
+        const ArchiveHeader &header = *reader.take<ArchiveHeader>(1);
+        if (std::memcmp(header.magic, ARCHIVE_MAGIC, sizeof(header.magic)) != 0)
+            throw std::runtime_error(path + " is not a product archive");
+        if (header.version != PRODUCT_ARCHIVE_VERSION)
+            throw std::runtime_error(path + " has unsupported archive version " + std::to_string(header.version));
+        if (header.endianTag != ENDIAN_TAG || header.nodeSize != sizeof(FlatNode))
+            throw std::runtime_error(path + " was written on an incompatible platform");
+
+        const uint64_t *astOffsets = reader.take<uint64_t>(header.numAsts);
+        const ProductEntry *entries = reader.take<ProductEntry>(header.numProducts);
+        myAsts.reserve(header.numAsts);
+        for (uint64_t i = 0; i < header.numAsts; ++i)
+            myAsts.push_back(readAst(myFile, astOffsets[i]));
+        myProducts.reserve(header.numProducts);
+        for (uint64_t i = 0; i < header.numProducts; ++i)
+        {
+            if (entries[i].ast >= myAsts.size() || entries[i].dates % 8 != 0 || entries[i].dates > myFile->size())
+                throw std::runtime_error("Corrupt product archive");
+            Reader dates(myFile->data(), myFile->size(), entries[i].dates);
+            dates.take<int32_t>(myAsts[entries[i].ast]->numEvents());
+            myProducts.emplace_back(entries[i].ast, entries[i].dates);
+        }
+    };
+
+    Product ProductArchive::product(size_t i) const
+    {
+        const auto &[ast, offset] = myProducts.at(i);
+        const int32_t *serials = reinterpret_cast<const int32_t *>(myFile->data() + offset);
+        std::vector<Date> dates;
+        dates.reserve(myAsts[ast]->numEvents());
+        for (size_t k = 0; k < myAsts[ast]->numEvents(); ++k)
+            dates.push_back(Date(static_cast<Date::serial_type>(serials[k])));
+        return Product(std::move(dates), myAsts[ast]);
+    };
+}
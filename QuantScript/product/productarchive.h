@@ -0,0 +1,39 @@
+#pragma once
+#include "product/product.h"
+#include "nodes/flatast.h"
+#include "others/mappedfile.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace QuantScript
+{
+    // Bumped whenever the layout of FlatNode or of the file changes
+    constexpr uint32_t PRODUCT_ARCHIVE_VERSION = 1;
+
+    // Binary file of flattened products: event dates, nodes, constants and variable
+    // names. Products sharing a FlatAst (see ProductCache) store it once. The file is
+    // mapped on load and the FlatAsts view it in place, nodes and constants are never copied.
+    // Files are only portable between builds with the same endianness and FlatNode layout.
+    class ProductArchive
+    {
+        std::shared_ptr<const MappedFile> myFile;
+        std::vector<std::shared_ptr<const FlatAst>> myAsts;
+        // Per product: index into myAsts and offset of its dates in the file
+        std::vector<std::pair<uint64_t, uint64_t>> myProducts;
+
+    public:
+        // Write flattened products to path, throws std::runtime_error if a product is
+        // not flattened or the file cannot be written
+        static void write(const std::string &path, const std::vector<const Product *> &products);
+
+        // Map path and validate it, throws std::runtime_error on a bad or foreign file
+        ProductArchive(const std::string &path);
+
+        size_t size() const { return myProducts.size(); };
+        size_t numDistinctScripts() const { return myAsts.size(); };
+        // i-th product, sharing the mapped events with every other product of the same script
+        Product product(size_t i) const;
+    };
+}
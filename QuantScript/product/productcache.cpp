@@ -0,0 +1,69 @@
+#include "product/productcache.h"
+#include "others/hash.h"
+
+namespace QuantScript {
+    size_t ProductCache::KeyHash::operator()(std::string_view key) const {
+        return static_cast<size_t>(fnv1a(key));
+    };
+
+    ProductCache& ProductCache::getInstance() {
+        static ProductCache instance;
+        return instance;
+    };
+
+    void ProductCache::evict() {
+        while (myLru.size() > myCapacity) {
+            myIndex.erase(myLru.back().first);
+            myLru.pop_back();
+            ++myEvictions;
+        };
+    };
+
+    std::shared_ptr<const FlatAst> ProductCache::get(const std::string& key, const std::function<std::shared_ptr<const FlatAst>()>& build) {
+        {
+            std::lock_guard<std::mutex> lock(myMutex);
+            auto it = myIndex.find(key);
+            if (it != myIndex.end()) {
+                myLru.splice(myLru.begin(), myLru, it->second);
+                ++myHits;
+                return it->second->second;
+            };
+        }
+        ++myMisses;
+        auto ast = build();
+
+        std::lock_guard<std::mutex> lock(myMutex);
+        auto it = myIndex.find(key);
+        if (it != myIndex.end()) {
+            // Built concurrently by another thread
+            myLru.splice(myLru.begin(), myLru, it->second);
+            return it->second->second;
+        };
+        myLru.emplace_front(key, ast);
+        myIndex.emplace(myLru.front().first, myLru.begin());
+        evict();
+        return ast;
+    };
+
+    size_t ProductCache::size() const {
+        std::lock_guard<std::mutex> lock(myMutex);
+        return myLru.size();
+    };
+    size_t ProductCache::capacity() const {
+        std::lock_guard<std::mutex> lock(myMutex);
+        return myCapacity;
+    };
+    void ProductCache::setCapacity(size_t capacity) {
+        std::lock_guard<std::mutex> lock(myMutex);
+        myCapacity = capacity;
+        evict();
+    };
+    void ProductCache::clear() {
+        std::lock_guard<std::mutex> lock(myMutex);
+        myIndex.clear();
+        myLru.clear();
+        myHits = 0;
+        myMisses = 0;
+        myEvictions = 0;
+    };
+}
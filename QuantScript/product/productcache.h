@@ -0,0 +1,54 @@
+#pragma once
+#include "nodes/flatast.h"
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace QuantScript
+{
+    // Process-wide cache of parsed and indexed events, keyed by the normalized
+    // script text (macro-expanded, upper-cased tokens). Entries are immutable and
+    // shared between products; the least recently used is evicted when full.
+    class ProductCache
+    {
+        using Entry = std::pair<std::string, std::shared_ptr<const FlatAst>>;
+        struct KeyHash
+        {
+            size_t operator()(std::string_view key) const;
+        };
+
+        mutable std::mutex myMutex;
+        size_t myCapacity;
+        // Most recently used first, the index views keys stored in the list
+        std::list<Entry> myLru;
+        std::unordered_map<std::string_view, std::list<Entry>::iterator, KeyHash> myIndex;
+        std::atomic<size_t> myHits{0};
+        std::atomic<size_t> myMisses{0};
+        std::atomic<size_t> myEvictions{0};
+
+        void evict();
+
+    public:
+        static ProductCache &getInstance();
+        ProductCache(size_t capacity = 1024) : myCapacity(capacity) {};
+        ProductCache(const ProductCache &) = delete;
+        ProductCache &operator=(const ProductCache &) = delete;
+
+        // Cached events for key, built with build on a miss. Building happens
+        // outside the lock, concurrent misses on one key keep the first result
+        std::shared_ptr<const FlatAst> get(const std::string &key, const std::function<std::shared_ptr<const FlatAst>()> &build);
+
+        size_t hits() const { return myHits; };
+        size_t misses() const { return myMisses; };
+        size_t evictions() const { return myEvictions; };
+        size_t size() const;
+        size_t capacity() const;
+        void setCapacity(size_t capacity);
+        void clear();
+    };
+}
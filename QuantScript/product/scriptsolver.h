@@ -0,0 +1,188 @@
+#pragma once
+#include "product/product.h"
+#include "product/aadval.h"
+#include "models/models.h"
+#include "models/pathstore.h"
+#include <automatic/aad.h>
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace QuantScript
+{
+    // Settings of solveScript
+    struct ScriptSolverSettings
+    {
+        // First guess of the SOLVE() value
+        double guess = 0.0;
+        // Bounds of the SOLVE() value, steps never leave them
+        double lower = -std::numeric_limits<double>::infinity();
+        double upper = std::numeric_limits<double>::infinity();
+        // Converged when the target is within tolerance of its value or the bracket is narrower than xTolerance
+        double tolerance = 1.0e-8;
+        double xTolerance = 1.0e-12;
+        size_t maxEvaluations = 20;
+    };
+
+    // Result of solveScript
+    struct ScriptSolverResult
+    {
+        // SOLVE() value and Monte-Carlo value of the target there
+        double root = 0.0;
+        double value = 0.0;
+        // Evaluations over all paths
+        size_t evaluations = 0;
+        bool converged = false;
+    };
+
+    // Monte-Carlo value of the target variable and its derivative to the SOLVE() value x,
+    // over the stored paths. x is the only input on tape, each path rewinds to the mark
+    // after it and propagates to it, the derivative is propagated once at the end
+    inline std::pair<double, double> solverValueAAD(Product &prd, const PathStore &paths,
+                                                    const std::vector<size_t> &indices, const size_t idx, const double x)
+    {
+        Tape &tape = *Number::tape;
+        tape.clear();
+        auto resetter = setNumResultsForAAD();
+        Number solverValue(x);
+        Scenario<Number> scenario(prd.eventDates().size());
+        std::unique_ptr<Evaluator<Number>> tree;
+        std::unique_ptr<FlatEvaluator<Number>> flat;
+        if (prd.sharedFlat())
+        {
+            flat = prd.buildFlatEvaluator<Number>();
+            for (uint32_t slot = 0; slot < prd.flat().numSolvers(); ++slot)
+                flat->setSolverValue(slot, solverValue);
+        }
+        else
+        {
+            tree = prd.buildEvaluator<Number>();
+            tree->setSolverValue(&solverValue);
+        }
+        tape.mark();
+
+        double value = 0.0;
+        for (size_t p = 0; p < paths.numPaths(); ++p)
+        {
+            tape.rewindToMark();
+            paths.load(p, indices, scenario);
+            const std::vector<Number> *vals;
+            if (flat)
+            {
+                flat->init();
+                prd.evaluate(scenario, *flat);
+                vals = &flat->variables();
+            }
+            else
+            {
+                tree->init();
+                prd.evaluate(scenario, *tree);
+                vals = &tree->variables();
+            }
+            Number result = (*vals)[idx];
+            result.propagateToMark();
+            value += double(result);
+        }
+        Number::propagateMarkToStart();
+        const double derivative = solverValue.adjoint() / double(paths.numPaths());
+        tape.clear();
+        return {value / double(paths.numPaths()), derivative};
+    };
+
+    // SOLVE() value for which the Monte-Carlo value of the target variable over the paths of
+    // a PathStore is targetValue. Every evaluation reads the same paths, so the value is a
+    // smooth function of the SOLVE() value. Each evaluation gives the value and its derivative
+    // by AAD and the next point is the Newton step, or the secant step when the derivative
+    // vanishes, falling back to bisection when the step leaves the bracket of the root.
+    // A target linear in SOLVE(), e.g. a par coupon, takes two evaluations.
+    // The root is written in the SOLVE() nodes of a product that is not flattened
+    inline ScriptSolverResult solveScript(Product &prd, const PathStore &paths, const std::string &target,
+                                          const double targetValue, const ScriptSolverSettings &settings = ScriptSolverSettings())
+    {
+        const size_t idx = targetIndex(prd, target);
+        const std::vector<size_t> indices = paths.indicesOf(prd.eventDates());
+        if (settings.guess < settings.lower || settings.guess > settings.upper)
+            throw std::runtime_error("Solver guess out of bounds");
+
+        // Points where the target is below and above targetValue, bracketing the root once both are known
+        bool hasBelow = false, hasAbove = false;
+        double below = 0.0, above = 0.0;
+        bool hasPrevious = false;
+        double xPrev = 0.0, fPrev = 0.0;
+
+        ScriptSolverResult result;
+        double x = settings.guess;
+        while (result.evaluations < settings.maxEvaluations)
+        {
+            const auto [value, derivative] = solverValueAAD(prd, paths, indices, idx, x);
+            ++result.evaluations;
+            result.root = x;
+            result.value = value;
+            const double f = value - targetValue;
+            if (std::fabs(f) <= settings.tolerance)
+            {
+                result.converged = true;
+                break;
+            }
+            if (f < 0.0)
+            {
+                hasBelow = true;
+                below = x;
+            }
+            else
+            {
+                hasAbove = true;
+                above = x;
+            }
+            const bool bracketed = hasBelow && hasAbove;
+            if (bracketed && std::fabs(above - below) <= settings.xTolerance)
+            {
+                result.converged = true;
+                break;
+            }
+            const double lo = bracketed ? std::min(below, above) : settings.lower;
+            const double hi = bracketed ? std::max(below, above) : settings.upper;
+
+            double next = std::numeric_limits<double>::quiet_NaN();
+            if (derivative != 0.0)
+                next = x - f / derivative;
+            if (!(next > lo && next < hi) && hasPrevious && f != fPrev)
+                next = x - f * (x - xPrev) / (f - fPrev);
+            if (!(next > lo && next < hi))
+            {
+                if (bracketed)
+                    next = 0.5 * (lo + hi);
+                else if (std::isfinite(next))
+                    // Halfway to the bound the step overshoots
+                    next = 0.5 * (x + (next <= lo ? lo : hi));
+                else
+                    throw std::runtime_error("Solver cannot step: the target does not depend on SOLVE()");
+            }
+
+            hasPrevious = true;
+            xPrev = x;
+            fPrev = f;
+            x = next;
+        }
+
+        if (!prd.sharedFlat())
+        {
+            SolverEvaluator<double> solver(target, targetValue);
+            prd.visit(solver);
+            solver.update(result.root);
+        }
+        return result;
+    };
+
+    // solveScript on numSim paths of model simulated once on the event dates of prd
+    inline ScriptSolverResult solveScript(Product &prd, const Model<double> &model, const RandomGen &random,
+                                          const size_t numSim, const std::string &target, const double targetValue,
+                                          const ScriptSolverSettings &settings = ScriptSolverSettings())
+    {
+        const PathStore paths(model, random, prd.eventDates(), numSim);
+        return solveScript(prd, paths, target, targetValue, settings);
+    };
+}
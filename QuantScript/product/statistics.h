@@ -0,0 +1,61 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace QuantScript
+{
+    // Running mean and variance of every variable of a product over paths, updated with
+    // Welford's recurrence so that adding a path allocates nothing. Accumulators of separate
+    // threads or batches merge with the pairwise formula of Chan, Golub and LeVeque
+    class PathStatistics
+    {
+        size_t myCount = 0;
+        std::vector<double> myMeans;
+        // Sums of squared deviations from the mean
+        std::vector<double> myM2;
+
+    public:
+        PathStatistics(size_t numVariables = 0) : myMeans(numVariables, 0.0), myM2(numVariables, 0.0) {};
+
+        // Add the variables of one path, e.g. Evaluator::variables()
+        template <class T>
+        void add(const std::vector<T> &values)
+        {
+            ++myCount;
+            const double n = double(myCount);
+            for (size_t v = 0; v < myMeans.size(); ++v)
+            {
+                const double x = double(values[v]);
+                const double delta = x - myMeans[v];
+                myMeans[v] += delta / n;
+                myM2[v] += delta * (x - myMeans[v]);
+            }
+        };
+        // Add the paths of another accumulator over the same variables
+        void merge(const PathStatistics &rhs)
+        {
+            if (rhs.myCount == 0)
+                return;
+            const double n = double(myCount + rhs.myCount);
+            const double weight = double(myCount) * double(rhs.myCount) / n;
+            for (size_t v = 0; v < myMeans.size(); ++v)
+            {
+                const double delta = rhs.myMeans[v] - myMeans[v];
+                myMeans[v] += delta * double(rhs.myCount) / n;
+                myM2[v] += rhs.myM2[v] + delta * delta * weight;
+            }
+            myCount += rhs.myCount;
+        };
+
+        size_t count() const { return myCount; };
+        size_t size() const { return myMeans.size(); };
+        // Monte-Carlo price of variable v
+        double mean(size_t v) const { return myMeans[v]; };
+        const std::vector<double> &means() const { return myMeans; };
+        // Sample variance of variable v over the paths
+        double variance(size_t v) const { return myCount > 1 ? myM2[v] / double(myCount - 1) : 0.0; };
+        // Standard error of the price of variable v
+        double standardError(size_t v) const { return myCount > 0 ? std::sqrt(variance(v) / double(myCount)) : 0.0; };
+    };
+}
@@ -0,0 +1,264 @@
+#include "codegen.h"
+#include "parser/parser.h"
+#include "config.hpp"
+#include <cmath>
+#include <cstdio>
+
+namespace QuantScript
+{
+    CodeGenerator::CodeGenerator(const std::vector<std::string> &varNames) : myVarNames(varNames) {};
+
+    std::string CodeGenerator::pop()
+    {
+        std::string res = std::move(myStack.back());
+        myStack.pop_back();
+        return res;
+    };
+    std::string CodeGenerator::argument(const Node &node, size_t i)
+    {
+        node.arguments[i]->acceptVisitor(*this);
+        return pop();
+    };
+    std::string CodeGenerator::constant(double value) const
+    {
+        // Literals like 1e400 and folded constants may overflow, which %g would print as inf or nan
+        if (std::isnan(value))
+            return "T(std::numeric_limits<double>::quiet_NaN())";
+        if (std::isinf(value))
+            return value > 0 ? "T(std::numeric_limits<double>::infinity())" : "T(-std::numeric_limits<double>::infinity())";
+        // Round-trips exactly through the compiler
+        char buf[40];
+        std::snprintf(buf, sizeof(buf), "T(%.17g)", value);
+        return buf;
+    };
+    void CodeGenerator::line(const std::string &code)
+    {
+        myBody << std::string(4 * myIndent, ' ') << code << "\n";
+    };
+
+    void CodeGenerator::generateUnary(const Node &node, const char *function)
+    {
+        myStack.push_back(std::string(function) + "(" + argument(node, 0) + ")");
+    };
+    void CodeGenerator::generateBinary(const Node &node, const char *op)
+    {
+        const std::string lhs = argument(node, 0);
+        const std::string rhs = argument(node, 1);
+        myStack.push_back("(" + lhs + " " + op + " " + rhs + ")");
+    };
+    void CodeGenerator::generateChain(const Node &node, const char *function)
+    {
+        // MAX and MIN accept more than two arguments, fold them left to right
+        std::string acc = argument(node, 0);
+        for (size_t i = 1; i < node.arguments.size(); ++i)
+            acc = std::string(function) + "(" + acc + ", " + argument(node, i) + ")";
+        myStack.push_back(acc);
+    };
+    void CodeGenerator::generateCompare(const Node &node, const char *format)
+    {
+        // Same EPS tolerances as the evaluator
+        const std::string lhs = argument(node, 0);
+        const std::string rhs = argument(node, 1);
+        char eps[32];
+        std::snprintf(eps, sizeof(eps), "%.17g", EPS);
+        std::string res = format;
+        for (auto [key, value] : {std::pair<std::string, std::string>{"$L", lhs}, {"$R", rhs}, {"$E", eps}})
+        {
+            const size_t pos = res.find(key);
+            res.replace(pos, key.size(), value);
+        }
+        myStack.push_back(res);
+    };
+
+    void CodeGenerator::generateEvent(const Event &event)
+    {
+        line("// Event " + std::to_string(myEvents));
+        line("{");
+        ++myIndent;
+        line("const T &spot = spots[" + std::to_string(myEvents) + "];");
+        line("const T &numeraire = numeraires[" + std::to_string(myEvents) + "];");
+        for (auto &statement : event)
+            statement->acceptVisitor(*this);
+        --myIndent;
+        line("}");
+        ++myEvents;
+    };
+
+    std::string CodeGenerator::source() const
+    {
+        std::ostringstream out;
+        out << "// Generated by QuantScript, do not edit\n"
+            << "#include <cmath>\n"
+            << "#include <algorithm>\n"
+            << "#include <limits>\n\n"
+            << "namespace qsgen\n{\n"
+            << "    template <class T>\n"
+            << "    void evaluate(T *vars, const T *spots, const T *numeraires)\n"
+            << "    {\n"
+            << "        using std::fabs;\n"
+            << "        using std::log;\n"
+            << "        using std::max;\n"
+            << "        using std::min;\n"
+            << "        using std::pow;\n"
+            << "        using std::sqrt;\n"
+            << "        (void)spots;\n"
+            << "        (void)numeraires;\n";
+        // Body was generated at one indentation level, move it inside the namespace
+        std::istringstream body(myBody.str());
+        for (std::string l; std::getline(body, l);)
+            out << "    " << l << "\n";
+        out << "    }\n}\n\n"
+            << "#ifndef QUANTSCRIPT_NO_C_ABI\n"
+            << "extern \"C\"\n{\n"
+            << "    unsigned qs_abi_version() { return " << CODEGEN_ABI_VERSION << "; }\n"
+            << "    unsigned qs_num_variables() { return " << myVarNames.size() << "; }\n"
+            << "    unsigned qs_num_events() { return " << myEvents << "; }\n"
+            << "    void qs_evaluate_double(double *vars, const double *spots, const double *numeraires)\n"
+            << "    {\n"
+            << "        qsgen::evaluate<double>(vars, spots, numeraires);\n"
+            << "    }\n"
+            << "}\n"
+            << "#endif\n";
+        return out.str();
+    };
+
+    void CodeGenerator::visitUplus(const NodeUplus &node)
+    {
+        node.arguments[0]->acceptVisitor(*this);
+    };
+    void CodeGenerator::visitUminus(const NodeUminus &node)
+    {
+        myStack.push_back("(-" + argument(node, 0) + ")");
+    };
+    void CodeGenerator::visitAdd(const NodeAdd &node)
+    {
+        generateBinary(node, "+");
+    };
+    void CodeGenerator::visitSubtract(const NodeSubtract &node)
+    {
+        generateBinary(node, "-");
+    };
+    void CodeGenerator::visitMult(const NodeMult &node)
+    {
+        generateBinary(node, "*");
+    };
+    void CodeGenerator::visitDiv(const NodeDiv &node)
+    {
+        generateBinary(node, "/");
+    };
+
+    // Advanced
+    void CodeGenerator::visitPow(const NodePow &node)
+    {
+        const std::string lhs = argument(node, 0);
+        const std::string rhs = argument(node, 1);
+        myStack.push_back("pow(" + lhs + ", " + rhs + ")");
+    };
+    void CodeGenerator::visitLog(const NodeLog &node)
+    {
+        generateUnary(node, "log");
+    };
+    void CodeGenerator::visitSqrt(const NodeSqrt &node)
+    {
+        generateUnary(node, "sqrt");
+    };
+    void CodeGenerator::visitMax(const NodeMax &node)
+    {
+        generateChain(node, "max");
+    };
+    void CodeGenerator::visitMin(const NodeMin &node)
+    {
+        generateChain(node, "min");
+    };
+
+    // Logic
+    void CodeGenerator::visitAssign(const NodeAssign &node)
+    {
+        const std::string lhs = argument(node, 0);
+        const std::string rhs = argument(node, 1);
+        line(lhs + " = " + rhs + ";");
+    };
+    void CodeGenerator::visitEqual(const NodeEqual &node)
+    {
+        generateCompare(node, "(fabs($L - $R) < $E)");
+    };
+    void CodeGenerator::visitDifferent(const NodeDifferent &node)
+    {
+        generateCompare(node, "(fabs($L - $R) > $E)");
+    };
+    void CodeGenerator::visitSuperior(const NodeSuperior &node)
+    {
+        generateCompare(node, "($L > $R + $E)");
+    };
+    void CodeGenerator::visitSupEqual(const NodeSupEqual &node)
+    {
+        generateCompare(node, "($L > $R - $E)");
+    };
+    void CodeGenerator::visitInferior(const NodeInferior &node)
+    {
+        generateCompare(node, "($L < $R - $E)");
+    };
+    void CodeGenerator::visitInfEqual(const NodeInfEqual &node)
+    {
+        generateCompare(node, "($L < $R + $E)");
+    };
+    void CodeGenerator::visitAnd(const NodeAnd &node)
+    {
+        generateBinary(node, "&&");
+    };
+    void CodeGenerator::visitOr(const NodeOr &node)
+    {
+        generateBinary(node, "||");
+    };
+
+    void CodeGenerator::visitIf(const NodeIf &node)
+    {
+        line("if " + argument(node, 0));
+        line("{");
+        ++myIndent;
+        const size_t lastTrue = node.firstElse == -1 ? node.arguments.size() - 1 : node.firstElse - 1;
+        for (size_t i = 1; i <= lastTrue; ++i)
+            node.arguments[i]->acceptVisitor(*this);
+        --myIndent;
+        line("}");
+        if (node.firstElse != -1)
+        {
+            line("else");
+            line("{");
+            ++myIndent;
+            for (size_t i = node.firstElse; i < node.arguments.size(); ++i)
+                node.arguments[i]->acceptVisitor(*this);
+            --myIndent;
+            line("}");
+        }
+    };
+    void CodeGenerator::visitSpot(const NodeSpot &node)
+    {
+        myStack.push_back("spot");
+    };
+    void CodeGenerator::visitConst(const NodeConst &node)
+    {
+        myStack.push_back(constant(node.value));
+    };
+    void CodeGenerator::visitVar(const NodeVar &node)
+    {
+        myStack.push_back("vars[" + std::to_string(node.index) + "] /* " + node.name + " */");
+    };
+    void CodeGenerator::visitPays(const NodePays &node)
+    {
+        const std::string lhs = argument(node, 0);
+        const std::string rhs = argument(node, 1);
+        line(lhs + " += " + rhs + " / numeraire;");
+    };
+
+    // Custom
+    void CodeGenerator::visitSolver(const NodeSolver &node)
+    {
+        // Solver values change between evaluations and cannot be baked into code
+        throw script_error("SOLVE is not supported by the code generator");
+    };
+    void CodeGenerator::visitDefinition(const NodeDefinition &node)
+    {
+        throw script_error("Definitions are not supported by the code generator");
+    };
+}
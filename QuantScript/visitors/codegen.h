@@ -0,0 +1,77 @@
+#pragma once
+#include "visitor.h"
+#include <sstream>
+
+namespace QuantScript
+{
+    // Version of the C interface exported by generated sources
+    static constexpr unsigned CODEGEN_ABI_VERSION = 1;
+
+    // Emits a C++ translation unit evaluating indexed events as straight-line code.
+    // The source defines a function template
+    //   template <class T> void qsgen::evaluate(T *vars, const T *spots, const T *numeraires)
+    // which can be compiled into a build with any number type (double, AAD numbers),
+    // and unless QUANTSCRIPT_NO_C_ABI is defined, C entry points for double:
+    //   unsigned qs_abi_version(), qs_num_variables(), qs_num_events()
+    //   void qs_evaluate_double(double *vars, const double *spots, const double *numeraires)
+    class CodeGenerator : public ConstVisitor
+    {
+        std::vector<std::string> myVarNames;
+        std::ostringstream myBody;
+        std::vector<std::string> myStack;
+        size_t myEvents = 0;
+        int myIndent = 1;
+
+        std::string pop();
+        std::string argument(const Node &node, size_t i);
+        std::string constant(double value) const;
+        void line(const std::string &code);
+        void generateUnary(const Node &node, const char *function);
+        void generateBinary(const Node &node, const char *op);
+        void generateChain(const Node &node, const char *function);
+        void generateCompare(const Node &node, const char *format);
+
+    public:
+        CodeGenerator(const std::vector<std::string> &varNames);
+        ~CodeGenerator() {};
+
+        void generateEvent(const Event &event);
+        // Complete translation unit, call once all events are generated
+        std::string source() const;
+
+        void visitUplus(const NodeUplus &node) override;
+        void visitUminus(const NodeUminus &node) override;
+        void visitAdd(const NodeAdd &node) override;
+        void visitSubtract(const NodeSubtract &node) override;
+        void visitMult(const NodeMult &node) override;
+        void visitDiv(const NodeDiv &node) override;
+
+        // Advanced
+        void visitPow(const NodePow &node) override;
+        void visitLog(const NodeLog &node) override;
+        void visitSqrt(const NodeSqrt &node) override;
+        void visitMax(const NodeMax &node) override;
+        void visitMin(const NodeMin &node) override;
+
+        // Logic
+        void visitAssign(const NodeAssign &node) override;
+        void visitEqual(const NodeEqual &node) override;
+        void visitDifferent(const NodeDifferent &node) override;
+        void visitSuperior(const NodeSuperior &node) override;
+        void visitSupEqual(const NodeSupEqual &node) override;
+        void visitInferior(const NodeInferior &node) override;
+        void visitInfEqual(const NodeInfEqual &node) override;
+        void visitAnd(const NodeAnd &node) override;
+        void visitOr(const NodeOr &node) override;
+
+        void visitIf(const NodeIf &node) override;
+        void visitSpot(const NodeSpot &node) override;
+        void visitConst(const NodeConst &node) override;
+        void visitVar(const NodeVar &node) override;
+        void visitPays(const NodePays &node) override;
+
+        // Custom
+        void visitSolver(const NodeSolver &node) override;
+        void visitDefinition(const NodeDefinition &node) override;
+    };
+}
@@ -0,0 +1,273 @@
+#include "compiler.h"
+#include "parser/parser.h"
+
+namespace QuantScript
+{
+    // Temporaries and constants are numbered provisionally while compiling
+    // and mapped onto the register file in program()
+    static constexpr uint32_t TEMP_FLAG = 0x80000000u;
+    static constexpr uint32_t CONST_FLAG = 0x40000000u;
+    static constexpr uint32_t SLOT_MASK = 0x3fffffffu;
+
+    Compiler::Compiler(size_t nVar)
+    {
+        myProgram.numVariables = nVar;
+    };
+
+    uint32_t Compiler::allocate()
+    {
+        myMaxTop = std::max(myMaxTop, myTop + 1);
+        return TEMP_FLAG | myTop++;
+    };
+    uint32_t Compiler::allocateBool()
+    {
+        myProgram.numBoolRegisters = std::max<size_t>(myProgram.numBoolRegisters, myBTop + 1);
+        return myBTop++;
+    };
+    uint32_t Compiler::constant(double value)
+    {
+        auto it = myConstMap.find(value);
+        if (it != myConstMap.end())
+            return CONST_FLAG | it->second;
+        const uint32_t k = static_cast<uint32_t>(myConstants.size());
+        myConstants.push_back(value);
+        myConstMap[value] = k;
+        return CONST_FLAG | k;
+    };
+    uint32_t Compiler::compileArgument(const Node &node, size_t i)
+    {
+        node.arguments[i]->acceptVisitor(*this);
+        return myResult;
+    };
+    void Compiler::emit(OpCode op, uint32_t dst, uint32_t lhs, uint32_t rhs)
+    {
+        myCode.push_back({op, dst, lhs, rhs});
+    };
+
+    void Compiler::compileUnary(const Node &node, OpCode op)
+    {
+        const uint32_t base = myTop;
+        const uint32_t arg = compileArgument(node, 0);
+        myTop = base;
+        myResult = allocate();
+        emit(op, myResult, arg);
+    };
+    void Compiler::compileBinary(const Node &node, OpCode op)
+    {
+        const uint32_t base = myTop;
+        const uint32_t lhs = compileArgument(node, 0);
+        const uint32_t rhs = compileArgument(node, 1);
+        // Operands are read before the result is written, so the result may reuse them
+        myTop = base;
+        myResult = allocate();
+        emit(op, myResult, lhs, rhs);
+    };
+    void Compiler::compileChain(const Node &node, OpCode op)
+    {
+        // MAX and MIN accept more than two arguments, fold them left to right
+        const uint32_t base = myTop;
+        uint32_t acc = compileArgument(node, 0);
+        for (size_t i = 1; i < node.arguments.size(); ++i)
+        {
+            const uint32_t rhs = compileArgument(node, i);
+            myTop = base;
+            const uint32_t dst = allocate();
+            emit(op, dst, acc, rhs);
+            acc = dst;
+        }
+        myResult = acc;
+    };
+    void Compiler::compileCompare(const Node &node, OpCode op)
+    {
+        const uint32_t base = myTop;
+        const uint32_t lhs = compileArgument(node, 0);
+        const uint32_t rhs = compileArgument(node, 1);
+        myTop = base;
+        myResult = allocateBool();
+        emit(op, myResult, lhs, rhs);
+    };
+
+    void Compiler::compileEvent(const Event &event)
+    {
+        myProgram.eventStart.push_back(myCode.size());
+        for (auto &statement : event)
+        {
+            myTop = 0;
+            myBTop = 0;
+            statement->acceptVisitor(*this);
+        }
+    };
+
+    Program Compiler::program()
+    {
+        Program prog = myProgram;
+        prog.eventStart.push_back(myCode.size());
+        prog.constants = myConstants;
+        const size_t firstTemp = prog.numVariables + myConstants.size();
+        prog.numRegisters = firstTemp + myMaxTop;
+
+        auto resolve = [&](uint32_t slot) -> uint32_t
+        {
+            if (slot & TEMP_FLAG)
+                return static_cast<uint32_t>(firstTemp + (slot & SLOT_MASK));
+            if (slot & CONST_FLAG)
+                return static_cast<uint32_t>(prog.numVariables + (slot & SLOT_MASK));
+            return slot;
+        };
+        prog.instructions = myCode;
+        for (auto &ins : prog.instructions)
+        {
+            switch (ins.op)
+            {
+            case OpCode::Equal:
+            case OpCode::Different:
+            case OpCode::Superior:
+            case OpCode::SupEqual:
+            case OpCode::Inferior:
+            case OpCode::InfEqual:
+                // Boolean result, numeric operands
+                ins.lhs = resolve(ins.lhs);
+                ins.rhs = resolve(ins.rhs);
+                break;
+            case OpCode::And:
+            case OpCode::Or:
+            case OpCode::If:
+            case OpCode::Else:
+            case OpCode::EndIf:
+                // Boolean registers and jump targets are final
+                break;
+            case OpCode::Spot:
+            case OpCode::Solver:
+                ins.dst = resolve(ins.dst);
+                break;
+            default:
+                ins.dst = resolve(ins.dst);
+                ins.lhs = resolve(ins.lhs);
+                ins.rhs = resolve(ins.rhs);
+                break;
+            }
+        }
+        return prog;
+    };
+
+    void Compiler::visitUplus(const NodeUplus &node) { node.arguments[0]->acceptVisitor(*this); };
+    void Compiler::visitUminus(const NodeUminus &node) { compileUnary(node, OpCode::Neg); };
+    void Compiler::visitAdd(const NodeAdd &node) { compileBinary(node, OpCode::Add); };
+    void Compiler::visitSubtract(const NodeSubtract &node) { compileBinary(node, OpCode::Subtract); };
+    void Compiler::visitMult(const NodeMult &node) { compileBinary(node, OpCode::Mult); };
+    void Compiler::visitDiv(const NodeDiv &node) { compileBinary(node, OpCode::Div); };
+
+    // Advanced
+    void Compiler::visitPow(const NodePow &node) { compileBinary(node, OpCode::Pow); };
+    void Compiler::visitLog(const NodeLog &node) { compileUnary(node, OpCode::Log); };
+    void Compiler::visitSqrt(const NodeSqrt &node) { compileUnary(node, OpCode::Sqrt); };
+    void Compiler::visitMax(const NodeMax &node) { compileChain(node, OpCode::Max); };
+    void Compiler::visitMin(const NodeMin &node) { compileChain(node, OpCode::Min); };
+
+    // Logic
+    void Compiler::visitAssign(const NodeAssign &node)
+    {
+        const uint32_t var = compileArgument(node, 0);
+        const uint32_t rhs = compileArgument(node, 1);
+        // The last instruction produced the temporary holding the rhs,
+        // redirect it straight into the variable
+        if ((rhs & TEMP_FLAG) && !myCode.empty() && myCode.back().dst == rhs)
+            myCode.back().dst = var;
+        else
+            emit(OpCode::Move, var, rhs);
+    };
+    void Compiler::visitEqual(const NodeEqual &node) { compileCompare(node, OpCode::Equal); };
+    void Compiler::visitDifferent(const NodeDifferent &node) { compileCompare(node, OpCode::Different); };
+    void Compiler::visitSuperior(const NodeSuperior &node) { compileCompare(node, OpCode::Superior); };
+    void Compiler::visitSupEqual(const NodeSupEqual &node) { compileCompare(node, OpCode::SupEqual); };
+    void Compiler::visitInferior(const NodeInferior &node) { compileCompare(node, OpCode::Inferior); };
+    void Compiler::visitInfEqual(const NodeInfEqual &node) { compileCompare(node, OpCode::InfEqual); };
+    void Compiler::visitAnd(const NodeAnd &node)
+    {
+        const uint32_t base = myBTop;
+        const uint32_t lhs = compileArgument(node, 0);
+        const uint32_t rhs = compileArgument(node, 1);
+        myBTop = base;
+        myResult = allocateBool();
+        emit(OpCode::And, myResult, lhs, rhs);
+    };
+    void Compiler::visitOr(const NodeOr &node)
+    {
+        const uint32_t base = myBTop;
+        const uint32_t lhs = compileArgument(node, 0);
+        const uint32_t rhs = compileArgument(node, 1);
+        myBTop = base;
+        myResult = allocateBool();
+        emit(OpCode::Or, myResult, lhs, rhs);
+    };
+
+    void Compiler::visitIf(const NodeIf &node)
+    {
+        // Condition
+        const uint32_t cond = compileArgument(node, 0);
+        myTop = 0;
+        myBTop = 0;
+        const size_t ifPos = myCode.size();
+        emit(OpCode::If, 0, cond);
+        // True statements
+        const size_t lastTrue = node.firstElse == -1 ? node.arguments.size() - 1 : node.firstElse - 1;
+        for (size_t i = 1; i <= lastTrue; ++i)
+        {
+            node.arguments[i]->acceptVisitor(*this);
+            myTop = 0;
+            myBTop = 0;
+        }
+        if (node.firstElse != -1)
+        {
+            const size_t elsePos = myCode.size();
+            emit(OpCode::Else, 0);
+            myCode[ifPos].rhs = static_cast<uint32_t>(elsePos);
+            // False statements
+            for (size_t i = node.firstElse; i < node.arguments.size(); ++i)
+            {
+                node.arguments[i]->acceptVisitor(*this);
+                myTop = 0;
+                myBTop = 0;
+            }
+            myCode[elsePos].rhs = static_cast<uint32_t>(myCode.size());
+        }
+        else
+        {
+            myCode[ifPos].rhs = static_cast<uint32_t>(myCode.size());
+        }
+        emit(OpCode::EndIf, 0);
+    };
+    void Compiler::visitSpot(const NodeSpot &node)
+    {
+        myResult = allocate();
+        emit(OpCode::Spot, myResult);
+    };
+    void Compiler::visitConst(const NodeConst &node)
+    {
+        myResult = constant(node.value);
+    };
+    void Compiler::visitVar(const NodeVar &node)
+    {
+        myResult = node.index;
+    };
+    void Compiler::visitPays(const NodePays &node)
+    {
+        const uint32_t var = compileArgument(node, 0);
+        const uint32_t rhs = compileArgument(node, 1);
+        emit(OpCode::Pays, var, rhs);
+    };
+
+    // Custom
+    void Compiler::visitSolver(const NodeSolver &node)
+    {
+        // Solver values are updated in place between evaluations, read them through a pointer
+        const uint32_t k = static_cast<uint32_t>(myProgram.solverValues.size());
+        myProgram.solverValues.push_back(&node.value);
+        myResult = allocate();
+        emit(OpCode::Solver, myResult, k);
+    };
+    void Compiler::visitDefinition(const NodeDefinition &node)
+    {
+        throw script_error("Definition nodes cannot be compiled");
+    };
+}
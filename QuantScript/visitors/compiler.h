@@ -0,0 +1,74 @@
+#pragma once
+#include "visitor.h"
+#include "bytecode/bytecode.h"
+#include <unordered_map>
+
+namespace QuantScript
+{
+    // Compiles indexed events into a linear register program,
+    // operands are resolved to register slots at compile time
+    class Compiler : public ConstVisitor
+    {
+        Program myProgram;
+        std::unordered_map<double, uint32_t> myConstMap;
+        std::vector<double> myConstants;
+        std::vector<Instruction> myCode;
+        uint32_t myTop = 0;
+        uint32_t myMaxTop = 0;
+        uint32_t myBTop = 0;
+        uint32_t myResult = 0;
+
+        uint32_t allocate();
+        uint32_t allocateBool();
+        uint32_t constant(double value);
+        uint32_t compileArgument(const Node &node, size_t i);
+        void emit(OpCode op, uint32_t dst, uint32_t lhs = 0, uint32_t rhs = 0);
+        void compileUnary(const Node &node, OpCode op);
+        void compileBinary(const Node &node, OpCode op);
+        void compileChain(const Node &node, OpCode op);
+        void compileCompare(const Node &node, OpCode op);
+
+    public:
+        Compiler(size_t nVar);
+        ~Compiler() {};
+
+        void compileEvent(const Event &event);
+        // Resolve temporaries and constants, must be called once all events are compiled
+        Program program();
+
+        void visitUplus(const NodeUplus &node) override;
+        void visitUminus(const NodeUminus &node) override;
+        void visitAdd(const NodeAdd &node) override;
+        void visitSubtract(const NodeSubtract &node) override;
+        void visitMult(const NodeMult &node) override;
+        void visitDiv(const NodeDiv &node) override;
+
+        // Advanced
+        void visitPow(const NodePow &node) override;
+        void visitLog(const NodeLog &node) override;
+        void visitSqrt(const NodeSqrt &node) override;
+        void visitMax(const NodeMax &node) override;
+        void visitMin(const NodeMin &node) override;
+
+        // Logic
+        void visitAssign(const NodeAssign &node) override;
+        void visitEqual(const NodeEqual &node) override;
+        void visitDifferent(const NodeDifferent &node) override;
+        void visitSuperior(const NodeSuperior &node) override;
+        void visitSupEqual(const NodeSupEqual &node) override;
+        void visitInferior(const NodeInferior &node) override;
+        void visitInfEqual(const NodeInfEqual &node) override;
+        void visitAnd(const NodeAnd &node) override;
+        void visitOr(const NodeOr &node) override;
+
+        void visitIf(const NodeIf &node) override;
+        void visitSpot(const NodeSpot &node) override;
+        void visitConst(const NodeConst &node) override;
+        void visitVar(const NodeVar &node) override;
+        void visitPays(const NodePays &node) override;
+
+        // Custom
+        void visitSolver(const NodeSolver &node) override;
+        void visitDefinition(const NodeDefinition &node) override;
+    };
+}
@@ -0,0 +1,150 @@
+#include "constfolder.h"
+#include <algorithm>
+
+namespace QuantScript {
+    static size_t countNodes(const Node& node) {
+        size_t n = 1;
+        for (auto& arg : node.arguments) {
+            n += countNodes(*arg);
+        };
+        return n;
+    };
+    static const NodeConst* asConst(const ExpressionTree& tree) {
+        return dynamic_cast<const NodeConst*>(tree.get());
+    };
+    static bool isConst(const ExpressionTree& tree, const double value) {
+        auto c = asConst(tree);
+        return c && c->value == value;
+    };
+
+    void ConstFolder::fold(Statement& statement) {
+        const size_t before = countNodes(*statement);
+        statement->acceptVisitor(*this);
+        myReplacement.reset();
+        myRemoved += before - countNodes(*statement);
+    };
+    size_t ConstFolder::removed() const {
+        return myRemoved;
+    };
+
+    void ConstFolder::foldArguments(Node& node) {
+        for (auto& arg : node.arguments) {
+            arg->acceptVisitor(*this);
+            if (myReplacement) {
+                // The replacement may be a child of arg, so take it before arg is destroyed
+                ExpressionTree replacement = std::move(myReplacement);
+                arg = std::move(replacement);
+            };
+        };
+    };
+    template <class F>
+    void ConstFolder::foldUnary(Node& node, F f) {
+        foldArguments(node);
+        if (auto c = asConst(node.arguments[0])) {
+            myReplacement = make_node<NodeConst>(f(c->value));
+        };
+    };
+    template <class F>
+    void ConstFolder::foldBinary(Node& node, F f) {
+        foldArguments(node);
+        auto lhs = asConst(node.arguments[0]);
+        auto rhs = asConst(node.arguments[1]);
+        if (lhs && rhs) {
+            myReplacement = make_node<NodeConst>(f(lhs->value, rhs->value));
+        };
+    };
+    template <class F>
+    void ConstFolder::foldChain(Node& node, F f) {
+        foldArguments(node);
+        const size_t nConst = std::count_if(node.arguments.begin(), node.arguments.end(),
+            [](const ExpressionTree& arg) { return asConst(arg) != nullptr; });
+        if (nConst < 2) return;
+        // Merge all constant arguments into one, placed last
+        std::vector<ExpressionTree> args;
+        double merged = 0.0;
+        bool first = true;
+        for (auto& arg : node.arguments) {
+            if (auto c = asConst(arg)) {
+                merged = first ? c->value : f(merged, c->value);
+                first = false;
+            }
+            else {
+                args.push_back(std::move(arg));
+            };
+        };
+        if (args.empty()) {
+            myReplacement = make_node<NodeConst>(merged);
+            return;
+        };
+        args.push_back(make_node<NodeConst>(merged));
+        node.arguments = std::move(args);
+    };
+
+    void ConstFolder::visitUplus(NodeUplus& node) {
+        foldArguments(node);
+        myReplacement = std::move(node.arguments[0]);
+    };
+    void ConstFolder::visitUminus(NodeUminus& node) {
+        foldUnary(node, [](double x) { return -x; });
+        if (!myReplacement && dynamic_cast<NodeUminus*>(node.arguments[0].get())) {
+            // -(-x) = x
+            myReplacement = std::move(node.arguments[0]->arguments[0]);
+        };
+    };
+    void ConstFolder::visitAdd(NodeAdd& node) {
+        foldBinary(node, [](double x, double y) { return x + y; });
+        if (myReplacement) return;
+        if (isConst(node.arguments[1], 0.0)) myReplacement = std::move(node.arguments[0]);
+        else if (isConst(node.arguments[0], 0.0)) myReplacement = std::move(node.arguments[1]);
+    };
+    void ConstFolder::visitSubtract(NodeSubtract& node) {
+        foldBinary(node, [](double x, double y) { return x - y; });
+        if (myReplacement) return;
+        if (isConst(node.arguments[1], 0.0)) myReplacement = std::move(node.arguments[0]);
+    };
+    void ConstFolder::visitMult(NodeMult& node) {
+        foldBinary(node, [](double x, double y) { return x * y; });
+        if (myReplacement) return;
+        if (isConst(node.arguments[1], 1.0)) myReplacement = std::move(node.arguments[0]);
+        else if (isConst(node.arguments[0], 1.0)) myReplacement = std::move(node.arguments[1]);
+    };
+    void ConstFolder::visitDiv(NodeDiv& node) {
+        foldBinary(node, [](double x, double y) { return x / y; });
+        if (myReplacement) return;
+        if (isConst(node.arguments[1], 1.0)) myReplacement = std::move(node.arguments[0]);
+    };
+
+    //Advanced
+    void ConstFolder::visitPow(NodePow& node) {
+        foldBinary(node, [](double x, double y) { return std::pow(x, y); });
+        if (myReplacement) return;
+        if (isConst(node.arguments[1], 1.0)) myReplacement = std::move(node.arguments[0]);
+        else if (isConst(node.arguments[1], 0.0)) myReplacement = make_node<NodeConst>(1.0);
+    };
+    void ConstFolder::visitLog(NodeLog& node) {
+        foldUnary(node, [](double x) { return std::log(x); });
+    };
+    void ConstFolder::visitSqrt(NodeSqrt& node) {
+        foldUnary(node, [](double x) { return std::sqrt(x); });
+    };
+    void ConstFolder::visitMax(NodeMax& node) {
+        foldChain(node, [](double x, double y) { return std::max(x, y); });
+    };
+    void ConstFolder::visitMin(NodeMin& node) {
+        foldChain(node, [](double x, double y) { return std::min(x, y); });
+    };
+
+    //Logic, only numeric subtrees are folded
+    void ConstFolder::visitAssign(NodeAssign& node) { foldArguments(node); };
+    void ConstFolder::visitEqual(NodeEqual& node) { foldArguments(node); };
+    void ConstFolder::visitDifferent(NodeDifferent& node) { foldArguments(node); };
+    void ConstFolder::visitSuperior(NodeSuperior& node) { foldArguments(node); };
+    void ConstFolder::visitSupEqual(NodeSupEqual& node) { foldArguments(node); };
+    void ConstFolder::visitInferior(NodeInferior& node) { foldArguments(node); };
+    void ConstFolder::visitInfEqual(NodeInfEqual& node) { foldArguments(node); };
+    void ConstFolder::visitAnd(NodeAnd& node) { foldArguments(node); };
+    void ConstFolder::visitOr(NodeOr& node) { foldArguments(node); };
+
+    void ConstFolder::visitIf(NodeIf& node) { foldArguments(node); };
+    void ConstFolder::visitPays(NodePays& node) { foldArguments(node); };
+}
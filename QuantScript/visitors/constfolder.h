@@ -0,0 +1,53 @@
+#pragma once
+#include "visitor.h"
+
+namespace QuantScript {
+    // Folds constant subtrees and simplifies identities (x*1, x+0, x^1...) in place
+    class ConstFolder : public Visitor {
+        // Set by a visit when the visited node must be replaced in its parent
+        ExpressionTree myReplacement;
+        size_t myRemoved = 0;
+
+        void foldArguments(Node& node);
+        template <class F>
+        void foldBinary(Node& node, F f);
+        template <class F>
+        void foldUnary(Node& node, F f);
+        template <class F>
+        void foldChain(Node& node, F f);
+    public:
+        ~ConstFolder() {};
+        // Fold a top level statement
+        void fold(Statement& statement);
+        // Number of nodes removed so far
+        size_t removed() const;
+
+        void visitUplus(NodeUplus& node) override;
+        void visitUminus(NodeUminus& node) override;
+        void visitAdd(NodeAdd& node) override;
+        void visitSubtract(NodeSubtract& node) override;
+        void visitMult(NodeMult& node) override;
+        void visitDiv(NodeDiv& node) override;
+
+        //Advanced
+        void visitPow(NodePow& node) override;
+        void visitLog(NodeLog& node) override;
+        void visitSqrt(NodeSqrt& node) override;
+        void visitMax(NodeMax& node) override;
+        void visitMin(NodeMin& node) override;
+
+        //Logic
+        void visitAssign(NodeAssign& node) override;
+        void visitEqual(NodeEqual& node) override;
+        void visitDifferent(NodeDifferent& node) override;
+        void visitSuperior(NodeSuperior& node) override;
+        void visitSupEqual(NodeSupEqual& node) override;
+        void visitInferior(NodeInferior& node) override;
+        void visitInfEqual(NodeInfEqual& node) override;
+        void visitAnd(NodeAnd& node) override;
+        void visitOr(NodeOr& node) override;
+
+        void visitIf(NodeIf& node) override;
+        void visitPays(NodePays& node) override;
+    };
+}
@@ -0,0 +1,252 @@
+#include "cseliminator.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace QuantScript {
+    // Labels a single node for hashing
+    class ExpressionLabeler : public ConstVisitor {
+    public:
+        std::string label;
+        bool numeric = false;
+        bool commutative = false;
+        bool leaf = false;
+        bool spot = false;
+        bool pure = true;
+        std::string var;
+
+        void reset() {
+            label.clear();
+            numeric = commutative = leaf = spot = false;
+            pure = true;
+            var.clear();
+        };
+        void op(const char* l, bool comm = false) {
+            label = l;
+            numeric = true;
+            commutative = comm;
+        };
+
+        void visitUplus(const NodeUplus& node) override { op("POS"); };
+        void visitUminus(const NodeUminus& node) override { op("NEG"); };
+        void visitAdd(const NodeAdd& node) override { op("ADD", true); };
+        void visitSubtract(const NodeSubtract& node) override { op("SUB"); };
+        void visitMult(const NodeMult& node) override { op("MULT", true); };
+        void visitDiv(const NodeDiv& node) override { op("DIV"); };
+        void visitPow(const NodePow& node) override { op("POW"); };
+        void visitLog(const NodeLog& node) override { op("LOG"); };
+        void visitSqrt(const NodeSqrt& node) override { op("SQRT"); };
+        void visitMax(const NodeMax& node) override { op("MAX", true); };
+        void visitMin(const NodeMin& node) override { op("MIN", true); };
+
+        // Conditions and statements are never replaced, only their operands
+        void visitAssign(const NodeAssign& node) override { label = "ASSIGN"; };
+        void visitEqual(const NodeEqual& node) override { label = "EQ"; };
+        void visitDifferent(const NodeDifferent& node) override { label = "NE"; };
+        void visitSuperior(const NodeSuperior& node) override { label = "GT"; };
+        void visitSupEqual(const NodeSupEqual& node) override { label = "GE"; };
+        void visitInferior(const NodeInferior& node) override { label = "LT"; };
+        void visitInfEqual(const NodeInfEqual& node) override { label = "LE"; };
+        void visitAnd(const NodeAnd& node) override { label = "AND"; };
+        void visitOr(const NodeOr& node) override { label = "OR"; };
+        void visitIf(const NodeIf& node) override { label = "IF"; };
+        void visitPays(const NodePays& node) override { label = "PAYS"; };
+
+        void visitSpot(const NodeSpot& node) override {
+            label = "SPOT";
+            leaf = spot = true;
+        };
+        void visitConst(const NodeConst& node) override {
+            // Exact representation, distinct constants must not collide
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%a", node.value);
+            label = buf;
+            leaf = true;
+        };
+        void visitVar(const NodeVar& node) override {
+            label = "$" + node.name;
+            leaf = true;
+            var = node.name;
+        };
+        // Solver values move between evaluations, definitions are not indexed yet
+        void visitSolver(const NodeSolver& node) override {
+            label = "SOLVE";
+            leaf = true;
+            pure = false;
+        };
+        void visitDefinition(const NodeDefinition& node) override {
+            label = "DEF";
+            leaf = true;
+            pure = false;
+        };
+    };
+
+    // Collects the variables written by a statement, including inside IF branches
+    class AssignedVars : public ConstVisitor {
+    public:
+        std::set<std::string> vars;
+        void visitAssign(const NodeAssign& node) override {
+            vars.insert(static_cast<const NodeVar&>(*node.arguments[0]).name);
+        };
+        void visitPays(const NodePays& node) override {
+            vars.insert(static_cast<const NodeVar&>(*node.arguments[0]).name);
+        };
+    };
+
+    const CseEliminator::Info& CseEliminator::describe(const Node& node) {
+        auto it = myInfo.find(&node);
+        if (it != myInfo.end()) return it->second;
+
+        ExpressionLabeler labeler;
+        node.acceptVisitor(labeler);
+        Info info;
+        info.spot = labeler.spot;
+        info.pure = labeler.pure;
+        if (!labeler.var.empty()) info.reads.insert(labeler.var);
+
+        std::vector<std::string> keys;
+        for (auto& arg : node.arguments) {
+            const Info& child = describe(*arg);
+            keys.push_back(child.key);
+            info.reads.insert(child.reads.begin(), child.reads.end());
+            info.spot = info.spot || child.spot;
+            info.pure = info.pure && child.pure;
+        };
+        if (labeler.commutative) std::sort(keys.begin(), keys.end());
+        info.key = labeler.label;
+        if (!labeler.leaf) {
+            info.key += "(";
+            for (size_t i = 0; i < keys.size(); ++i) {
+                if (i) info.key += ",";
+                info.key += keys[i];
+            };
+            info.key += ")";
+        };
+        info.candidate = labeler.numeric && info.pure;
+        return myInfo.emplace(&node, std::move(info)).first->second;
+    };
+
+    void CseEliminator::count(const Node& node) {
+        const Info& info = describe(node);
+        if (info.candidate) ++myCounts[info.key];
+        for (auto& arg : node.arguments) {
+            count(*arg);
+        };
+    };
+
+    void CseEliminator::invalidate(AvailMap& avail, const std::string& var) {
+        for (auto it = avail.begin(); it != avail.end();) {
+            if (it->second.info->reads.count(var)) it = avail.erase(it);
+            else ++it;
+        };
+    };
+
+    void CseEliminator::rewrite(ExpressionTree& slot, AvailMap& avail, std::vector<Statement>& hoisted) {
+        const Info& info = describe(*slot);
+        if (info.candidate) {
+            // Already computed and still valid: read the temporary
+            auto it = avail.find(info.key);
+            if (it != avail.end()) {
+                if (myApply) {
+                    myDiscarded.push_back(std::move(slot));
+                    slot = make_node<NodeVar>(it->second.temp);
+                    ++myReplaced;
+                }
+                else {
+                    ++myHits[it->second.id];
+                };
+                return;
+            };
+            // Repeated elsewhere: compute it into a temporary ahead of the statement
+            if (myCounts[info.key] > 1) {
+                const size_t id = myNextId++;
+                if (!myApply) myHits.push_back(0);
+                for (auto& arg : slot->arguments) {
+                    rewrite(arg, avail, hoisted);
+                };
+                // Only keep the sites the dry run found to be reused
+                if (!myApply || myHits[id] > 0) {
+                    std::string temp;
+                    if (myApply) {
+                        temp = myPrefix + std::to_string(myTemps++);
+                        ExpressionTree lhs = make_node<NodeVar>(temp);
+                        hoisted.push_back(buildBinary<NodeAssign>(lhs, slot));
+                        slot = make_node<NodeVar>(temp);
+                    };
+                    avail[info.key] = { temp, id, &info };
+                };
+                return;
+            };
+        };
+        for (auto& arg : slot->arguments) {
+            rewrite(arg, avail, hoisted);
+        };
+    };
+
+    void CseEliminator::processBlock(std::vector<Statement>& block, AvailMap& avail) {
+        std::vector<Statement> out;
+        out.reserve(block.size());
+        for (auto& statement : block) {
+            std::vector<Statement> hoisted;
+            if (auto ifNode = dynamic_cast<NodeIf*>(statement.get())) {
+                // The condition dominates both branches and what follows
+                rewrite(ifNode->arguments[0], avail, hoisted);
+                auto& args = ifNode->arguments;
+                const size_t lastTrue = ifNode->firstElse == -1 ? args.size() - 1 : ifNode->firstElse - 1;
+                std::vector<Statement> trueBlock, falseBlock;
+                for (size_t i = 1; i <= lastTrue; ++i) trueBlock.push_back(std::move(args[i]));
+                if (ifNode->firstElse != -1) {
+                    for (size_t i = ifNode->firstElse; i < args.size(); ++i) falseBlock.push_back(std::move(args[i]));
+                };
+                // Temporaries computed inside a branch stay inside it
+                AvailMap trueAvail = avail, falseAvail = avail;
+                processBlock(trueBlock, trueAvail);
+                processBlock(falseBlock, falseAvail);
+                args.resize(1);
+                for (auto& s : trueBlock) args.push_back(std::move(s));
+                if (ifNode->firstElse != -1) {
+                    ifNode->firstElse = static_cast<int>(args.size());
+                    for (auto& s : falseBlock) args.push_back(std::move(s));
+                };
+            }
+            else {
+                rewrite(statement->arguments[1], avail, hoisted);
+            };
+            AssignedVars assigned;
+            statement->acceptVisitor(assigned);
+            for (auto& var : assigned.vars) {
+                invalidate(avail, var);
+            };
+            for (auto& s : hoisted) out.push_back(std::move(s));
+            out.push_back(std::move(statement));
+        };
+        block = std::move(out);
+    };
+
+    size_t CseEliminator::eliminate(std::vector<Event>& events) {
+        for (auto& e : events) {
+            for (auto& s : e) {
+                count(*s);
+            };
+        };
+        // Dry run to find which hoisting sites are reused, then rewrite
+        for (bool apply : { false, true }) {
+            myApply = apply;
+            myNextId = 0;
+            AvailMap avail;
+            for (auto& e : events) {
+                processBlock(e, avail);
+                // SPOT() changes from one event to the next
+                for (auto it = avail.begin(); it != avail.end();) {
+                    if (it->second.info->spot) it = avail.erase(it);
+                    else ++it;
+                };
+            };
+        };
+        myDiscarded.clear();
+        myInfo.clear();
+        return myReplaced;
+    };
+    size_t CseEliminator::temporaries() const {
+        return myTemps;
+    };
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "visitor.h"
+#include <set>
+#include <unordered_map>
+
+namespace QuantScript {
+    // Common subexpression elimination over the events of a product.
+    // Repeated numeric subtrees are computed once into a temporary variable
+    // and later copies read the temporary. A temporary is only reused while
+    // none of the variables its expression reads has been assigned since,
+    // inside the IF branch that computed it, and SPOT() based expressions
+    // only within their own event.
+    class CseEliminator {
+        struct Info {
+            std::string key;
+            std::set<std::string> reads;
+            bool spot = false;
+            bool pure = true;
+            bool candidate = false;
+        };
+        struct Available {
+            std::string temp;
+            size_t id;
+            const Info* info;
+        };
+        using AvailMap = std::map<std::string, Available>;
+
+        std::string myPrefix;
+        std::unordered_map<const Node*, Info> myInfo;
+        std::unordered_map<std::string, size_t> myCounts;
+        // Number of reuses of each hoisting site, found by a dry run
+        std::vector<size_t> myHits;
+        // Replaced subtrees, kept alive so that node addresses are not recycled during a pass
+        std::vector<ExpressionTree> myDiscarded;
+        size_t myNextId = 0;
+        size_t myTemps = 0;
+        size_t myReplaced = 0;
+        bool myApply = false;
+
+        const Info& describe(const Node& node);
+        void count(const Node& node);
+        void processBlock(std::vector<Statement>& block, AvailMap& avail);
+        void rewrite(ExpressionTree& slot, AvailMap& avail, std::vector<Statement>& hoisted);
+        static void invalidate(AvailMap& avail, const std::string& var);
+    public:
+        CseEliminator(std::string prefix = "_CSE") : myPrefix(prefix) {};
+        // Rewrites events in place, returns the number of subtrees replaced by a temporary
+        size_t eliminate(std::vector<Event>& events);
+        // Number of temporaries introduced
+        size_t temporaries() const;
+    };
+}
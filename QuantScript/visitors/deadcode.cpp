@@ -0,0 +1,100 @@
+#include "deadcode.h"
+#include "parser/parser.h"
+#include <algorithm>
+
+namespace QuantScript {
+    // Collects the variables read by an expression
+    class VarReads : public ConstVisitor {
+    public:
+        std::set<std::string>& reads;
+        VarReads(std::set<std::string>& r) : reads(r) {};
+        void visitVar(const NodeVar& node) override {
+            reads.insert(node.name);
+        };
+    };
+
+    // Collects the variables written by statements
+    class VarWrites : public ConstVisitor {
+    public:
+        std::set<std::string> writes;
+        void visitAssign(const NodeAssign& node) override {
+            writes.insert(static_cast<const NodeVar&>(*node.arguments[0]).name);
+        };
+        void visitPays(const NodePays& node) override {
+            writes.insert(static_cast<const NodeVar&>(*node.arguments[0]).name);
+        };
+    };
+
+    DeadCodeEliminator::DeadCodeEliminator(const std::vector<std::string>& outputs) {
+        // Variable names are upper case after parsing
+        for (auto name : outputs) {
+            std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+            myLive.insert(name);
+        };
+    };
+
+    void DeadCodeEliminator::pruneBlock(std::vector<Statement>& block, std::set<std::string>& live) {
+        std::vector<Statement> kept;
+        for (auto it = block.rbegin(); it != block.rend(); ++it) {
+            Statement& statement = *it;
+            if (auto ifNode = dynamic_cast<NodeIf*>(statement.get())) {
+                auto& args = ifNode->arguments;
+                const size_t lastTrue = ifNode->firstElse == -1 ? args.size() - 1 : ifNode->firstElse - 1;
+                std::vector<Statement> trueBlock, falseBlock;
+                for (size_t i = 1; i <= lastTrue; ++i) trueBlock.push_back(std::move(args[i]));
+                if (ifNode->firstElse != -1) {
+                    for (size_t i = ifNode->firstElse; i < args.size(); ++i) falseBlock.push_back(std::move(args[i]));
+                };
+                // Either branch may run, a variable is live if it is live in one of them
+                std::set<std::string> trueLive = live, falseLive = live;
+                pruneBlock(trueBlock, trueLive);
+                pruneBlock(falseBlock, falseLive);
+                if (trueBlock.empty() && falseBlock.empty()) {
+                    ++myRemoved;
+                    continue;
+                };
+                args.resize(1);
+                for (auto& s : trueBlock) args.push_back(std::move(s));
+                if (ifNode->firstElse != -1) {
+                    ifNode->firstElse = static_cast<int>(args.size());
+                    for (auto& s : falseBlock) args.push_back(std::move(s));
+                };
+                live = std::move(trueLive);
+                live.insert(falseLive.begin(), falseLive.end());
+                VarReads reads(live);
+                args[0]->acceptVisitor(reads);
+            }
+            else {
+                const std::string& var = static_cast<const NodeVar&>(*statement->arguments[0]).name;
+                if (!live.count(var)) {
+                    ++myRemoved;
+                    continue;
+                };
+                // PAYS accumulates into its variable, which stays live
+                if (dynamic_cast<NodeAssign*>(statement.get())) live.erase(var);
+                VarReads reads(live);
+                statement->arguments[1]->acceptVisitor(reads);
+            };
+            kept.push_back(std::move(statement));
+        };
+        std::reverse(kept.begin(), kept.end());
+        block = std::move(kept);
+    };
+
+    size_t DeadCodeEliminator::eliminate(std::vector<Event>& events) {
+        VarWrites writes;
+        for (auto& e : events) {
+            for (auto& s : e) {
+                s->acceptVisitor(writes);
+            };
+        };
+        for (auto& name : myLive) {
+            if (!writes.writes.count(name)) throw script_error(("Output variable " + name + " is never assigned").c_str());
+        };
+        std::set<std::string> live = myLive;
+        for (auto it = events.rbegin(); it != events.rend(); ++it) {
+            pruneBlock(*it, live);
+        };
+        return myRemoved;
+    };
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "visitor.h"
+#include <set>
+
+namespace QuantScript {
+    // Backward liveness over the events of a product. Statements that cannot
+    // affect the requested output variables are removed, as are IF nodes
+    // left with no statement in either branch.
+    class DeadCodeEliminator {
+        std::set<std::string> myLive;
+        size_t myRemoved = 0;
+
+        // Prunes a block given the variables live after it, leaves those live before it in live
+        void pruneBlock(std::vector<Statement>& block, std::set<std::string>& live);
+    public:
+        DeadCodeEliminator(const std::vector<std::string>& outputs);
+        // Rewrites events in place, returns the number of statements removed
+        size_t eliminate(std::vector<Event>& events);
+    };
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include "visitor.h"
 #include "models/models.h"
+#include "others/staticstack.h"
 #include <cmath>
 #include "config.hpp"
 
@@ -10,31 +11,44 @@ namespace QuantScript
     template <class T>
     class Evaluator : public ConstVisitor
     {
+    protected:
         std::vector<T> myVariables;
         std::vector<T> myDefinitions;
-        quickStack<bool> myBStack;
-        quickStack<T> myDStack;
+        StaticStack<bool> myBStack;
+        StaticStack<T> myDStack;
         bool myLhsVar = false;
         T *myLhsVarAddr;
 
         const Scenario<T> *myScenario;
         size_t myCurrentEvent;
+        // Read by SOLVE() in place of NodeSolver::value when set
+        const T *mySolverValue = nullptr;
+#ifdef QUANTSCRIPT_CHECK_ALLOCATIONS
+        bool myWarm = false;
+#endif
 
     public:
         ~Evaluator() {};
         Evaluator(size_t nVar) : myVariables(nVar) {};
-        Evaluator(const Evaluator &rhs) : myVariables(rhs.myVariables) {}
+        // Stacks sized from StackDepth never allocate while evaluating
+        Evaluator(size_t nVar, size_t maxDepth, size_t maxBoolDepth)
+            : myVariables(nVar), myBStack(maxBoolDepth), myDStack(maxDepth) {};
+        Evaluator(const Evaluator &rhs) : myVariables(rhs.myVariables), myBStack(rhs.myBStack), myDStack(rhs.myDStack) {}
         Evaluator &operator=(const Evaluator &rhs)
         {
             if (this == &rhs)
                 return *this;
             myVariables = rhs.myVariables;
+            myBStack = rhs.myBStack;
+            myDStack = rhs.myDStack;
             return *this;
         }
-        Evaluator(Evaluator &&rhs) : myVariables(move(rhs.myVariables)) {}
+        Evaluator(Evaluator &&rhs) : myVariables(std::move(rhs.myVariables)), myBStack(std::move(rhs.myBStack)), myDStack(std::move(rhs.myDStack)) {}
         Evaluator &operator=(Evaluator &&rhs)
         {
-            myVariables = move(rhs.myVariables);
+            myVariables = std::move(rhs.myVariables);
+            myBStack = std::move(rhs.myBStack);
+            myDStack = std::move(rhs.myDStack);
             return *this;
         }
         // (Re-)initialize before evaluation in each scenario
@@ -44,10 +58,8 @@ namespace QuantScript
                 varIt = 0.0;
             // Stacks should be empty, if this is not the case we empty them
             // without affecting capacity for added performance
-            while (!myDStack.empty())
-                myDStack.pop();
-            while (!myBStack.empty())
-                myBStack.pop();
+            myDStack.clear();
+            myBStack.clear();
             myLhsVar = false;
             myLhsVarAddr = nullptr;
         }
@@ -56,6 +68,25 @@ namespace QuantScript
         {
             return myVariables;
         };
+        // Variables without a copy, valid until the next evaluation
+        const std::vector<T> &variables() const
+        {
+            return myVariables;
+        };
+        // Writable variables, e.g. to resume evaluation from a snapshot
+        std::vector<T> &variables()
+        {
+            return myVariables;
+        };
+#ifdef QUANTSCRIPT_CHECK_ALLOCATIONS
+        // False on the first call and true afterwards
+        bool warmedUp()
+        {
+            const bool warm = myWarm;
+            myWarm = true;
+            return warm;
+        };
+#endif
 
         void reverseVisitArguments(const Node &node)
         {
@@ -72,6 +103,12 @@ namespace QuantScript
         {
             myCurrentEvent = currentEvent;
         };
+        // Value of every SOLVE() node, e.g. an AAD Number to differentiate with respect to it.
+        // Null to read the values stored in the nodes
+        void setSolverValue(const T *value)
+        {
+            mySolverValue = value;
+        };
 
         // Aux
         std::pair<T, T> pop2()
@@ -152,14 +189,27 @@ namespace QuantScript
         void visitMax(const NodeMax &node)
         {
             reverseVisitArguments(node);
-            auto res = pop2();
-            myDStack.push(std::max(res.first, res.second));
+            // MAX accepts more than two arguments, arg0 is on top
+            T res = myDStack.top();
+            myDStack.pop();
+            for (size_t i = 1; i < node.arguments.size(); ++i)
+            {
+                res = std::max(res, myDStack.top());
+                myDStack.pop();
+            }
+            myDStack.push(res);
         };
         void visitMin(const NodeMin &node)
         {
             reverseVisitArguments(node);
-            auto res = pop2();
-            myDStack.push(std::min(res.first, res.second));
+            T res = myDStack.top();
+            myDStack.pop();
+            for (size_t i = 1; i < node.arguments.size(); ++i)
+            {
+                res = std::min(res, myDStack.top());
+                myDStack.pop();
+            }
+            myDStack.push(res);
         };
 
         // Logic
@@ -213,13 +263,13 @@ namespace QuantScript
         void visitAnd(const NodeAnd &node)
         {
             reverseVisitArguments(node);
-            auto res = pop2();
+            auto res = pop2b();
             myBStack.push(res.first && res.second);
         };
         void visitOr(const NodeOr &node)
         {
             reverseVisitArguments(node);
-            auto res = pop2();
+            auto res = pop2b();
             myBStack.push(res.first || res.second);
         };
 
@@ -250,11 +300,11 @@ namespace QuantScript
         };
         void visitSpot(const NodeSpot &node)
         {
-            myDStack.push((*myScenario)[myCurrentEvent].spot);
+            myDStack.push(myScenario->spot(myCurrentEvent));
         };
         void visitConst(const NodeConst &node)
         {
-            myDStack.push(node.value);
+            myDStack.push(T(node.value));
         };
         void visitVar(const NodeVar &node)
         {
@@ -277,14 +327,14 @@ namespace QuantScript
             // Visit the RHS expression
             node.arguments[1]->acceptVisitor(*this);
             // Write result into variable
-            *myLhsVarAddr += myDStack.top() / (*myScenario)[myCurrentEvent].numeraire;
+            *myLhsVarAddr += myDStack.top() / myScenario->numeraire(myCurrentEvent);
             myDStack.pop();
         }
 
         // Custom
         void visitSolver(const NodeSolver &node)
         {
-            myDStack.push(node.value);
+            myDStack.push(mySolverValue ? *mySolverValue : T(node.value));
         };
         void visitDefinition(const NodeDefinition &node)
         {
@@ -0,0 +1,176 @@
+#pragma once
+#include "nodes/flatast.h"
+#include "models/models.h"
+#include "config.hpp"
+#include <cmath>
+#include <algorithm>
+
+namespace QuantScript
+{
+    // Evaluates a FlatAst by recursion over node indices, values are returned
+    // rather than pushed on stacks
+    template <class T>
+    class FlatEvaluator
+    {
+        const FlatAst *myAst;
+        const FlatNode *myNodes;
+        std::vector<T> myVariables;
+        std::vector<T> mySolverValues;
+        const Scenario<T> *myScenario = nullptr;
+        size_t myCurrentEvent = 0;
+
+        T value(uint32_t i)
+        {
+            const FlatNode &n = myNodes[i];
+            switch (n.kind)
+            {
+            case NodeKind::Uplus:
+                return value(n.first);
+            case NodeKind::Uminus:
+                return -value(n.first);
+            case NodeKind::Add:
+                return value(n.first) + value(n.first + 1);
+            case NodeKind::Subtract:
+                return value(n.first) - value(n.first + 1);
+            case NodeKind::Mult:
+                return value(n.first) * value(n.first + 1);
+            case NodeKind::Div:
+                return value(n.first) / value(n.first + 1);
+            case NodeKind::Pow:
+                return pow(value(n.first), value(n.first + 1));
+            case NodeKind::Log:
+                return log(value(n.first));
+            case NodeKind::Sqrt:
+                return sqrt(value(n.first));
+            case NodeKind::Max:
+            {
+                T res = value(n.first);
+                for (uint32_t c = 1; c < n.count; ++c)
+                    res = std::max(res, value(n.first + c));
+                return res;
+            }
+            case NodeKind::Min:
+            {
+                T res = value(n.first);
+                for (uint32_t c = 1; c < n.count; ++c)
+                    res = std::min(res, value(n.first + c));
+                return res;
+            }
+            case NodeKind::Spot:
+                return myScenario->spot(myCurrentEvent);
+            case NodeKind::Const:
+                return T(myAst->constant(n.data));
+            case NodeKind::Var:
+                return myVariables[n.data];
+            case NodeKind::Solver:
+                return mySolverValues[n.data];
+            default:
+                return T(0.0);
+            }
+        };
+
+        bool test(uint32_t i)
+        {
+            const FlatNode &n = myNodes[i];
+            switch (n.kind)
+            {
+            case NodeKind::And:
+                return test(n.first) && test(n.first + 1);
+            case NodeKind::Or:
+                return test(n.first) || test(n.first + 1);
+            default:
+                break;
+            }
+            const T lhs = value(n.first);
+            const T rhs = value(n.first + 1);
+            switch (n.kind)
+            {
+            case NodeKind::Equal:
+                return fabs(lhs - rhs) < EPS;
+            case NodeKind::Different:
+                return fabs(lhs - rhs) > EPS;
+            case NodeKind::Superior:
+                return lhs > rhs + EPS;
+            case NodeKind::SupEqual:
+                return lhs > rhs - EPS;
+            case NodeKind::Inferior:
+                return lhs < rhs - EPS;
+            case NodeKind::InfEqual:
+                return lhs < rhs + EPS;
+            default:
+                return false;
+            }
+        };
+
+        void run(uint32_t i)
+        {
+            const FlatNode &n = myNodes[i];
+            switch (n.kind)
+            {
+            case NodeKind::Assign:
+                myVariables[myNodes[n.first].data] = value(n.first + 1);
+                break;
+            case NodeKind::Pays:
+                myVariables[myNodes[n.first].data] += value(n.first + 1) / myScenario->numeraire(myCurrentEvent);
+                break;
+            case NodeKind::If:
+            {
+                const uint32_t end = n.count;
+                const uint32_t firstElse = n.data == FlatAst::NO_ELSE ? end : n.data;
+                if (test(n.first))
+                {
+                    for (uint32_t c = 1; c < firstElse; ++c)
+                        run(n.first + c);
+                }
+                else
+                {
+                    for (uint32_t c = firstElse; c < end; ++c)
+                        run(n.first + c);
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        };
+
+    public:
+        FlatEvaluator(const FlatAst &ast)
+            : myAst(&ast), myNodes(ast.nodes().data()), myVariables(ast.numVariables()), mySolverValues(ast.numSolvers()) {};
+
+        // (Re-)initialize before evaluation in each scenario
+        void init()
+        {
+            for (auto &v : myVariables)
+                v = 0.0;
+        };
+
+        std::vector<T> varVals() const
+        {
+            return myVariables;
+        };
+        // Variables without a copy, valid until the next evaluation
+        const std::vector<T> &variables() const
+        {
+            return myVariables;
+        };
+
+        // Value read by the SOLVE() node in the given slot, slots are numbered in script order
+        void setSolverValue(uint32_t slot, const T &v)
+        {
+            mySolverValues[slot] = v;
+        };
+
+        void evaluate(const Scenario<T> &scenario)
+        {
+            myScenario = &scenario;
+            const auto &events = myAst->events();
+            for (size_t e = 0; e < events.size(); ++e)
+            {
+                myCurrentEvent = e;
+                for (uint32_t s = events[e].first; s < events[e].first + events[e].count; ++s)
+                    run(s);
+            }
+        };
+    };
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include "visitors/evaluator.h"
+#include <cmath>
+
+namespace QuantScript
+{
+    // Evaluator with smoothed conditions. Comparisons produce a degree of truth in [0, 1],
+    // linear over a band of width eps around the boundary, AND/OR combine degrees as
+    // probabilities and an IF whose degree is strictly between 0 and 1 evaluates both
+    // branches and blends the variables they assign. Derivatives then flow through
+    // conditions, which keeps AAD greeks of digitals and barriers stable.
+    // IFs must have been processed with Product::processIfs
+    template <class T>
+    class FuzzyEvaluator : public Evaluator<T>
+    {
+        using Evaluator<T>::myVariables;
+        using Evaluator<T>::reverseVisitArguments;
+        using Evaluator<T>::pop2;
+
+        double myEps;
+        // Degrees of truth, in place of the boolean stack
+        StaticStack<T> myFStack;
+        // Saved and true-branch values of the IFs being blended, nested IFs stack up to myStoreTop
+        std::vector<T> myStore;
+        size_t myStoreTop = 0;
+
+        // Degree of truth of x > 0
+        T callSpread(const T &x) const
+        {
+            const double half = 0.5 * myEps;
+            if (x < -half)
+                return T(0.0);
+            if (x > half)
+                return T(1.0);
+            return (x + half) / myEps;
+        };
+        // Degree of truth of x == 0
+        T butterfly(const T &x) const
+        {
+            const double half = 0.5 * myEps;
+            if (x < -half || x > half)
+                return T(0.0);
+            return 1.0 - fabs(x) / half;
+        };
+        std::pair<T, T> pop2f()
+        {
+            std::pair<T, T> res;
+            res.first = myFStack.top();
+            myFStack.pop();
+            res.second = myFStack.top();
+            myFStack.pop();
+            return res;
+        };
+        void visitRange(const NodeIf &node, size_t first, size_t last)
+        {
+            for (size_t i = first; i <= last; ++i)
+                node.arguments[i]->acceptVisitor(*this);
+        };
+
+    public:
+        // eps is the width of the band over which conditions go from false to true,
+        // storeSize is StackDepth::maxFuzzyStore so that blending never allocates
+        FuzzyEvaluator(size_t nVar, size_t maxDepth, size_t maxBoolDepth, size_t storeSize, double eps)
+            : Evaluator<T>(nVar, maxDepth, maxBoolDepth), myEps(eps), myFStack(maxBoolDepth), myStore(storeSize) {};
+
+        void visitEqual(const NodeEqual &node) override
+        {
+            reverseVisitArguments(node);
+            auto res = pop2();
+            myFStack.push(butterfly(res.first - res.second));
+        };
+        void visitDifferent(const NodeDifferent &node) override
+        {
+            reverseVisitArguments(node);
+            auto res = pop2();
+            myFStack.push(1.0 - butterfly(res.first - res.second));
+        };
+        void visitSuperior(const NodeSuperior &node) override
+        {
+            reverseVisitArguments(node);
+            auto res = pop2();
+            myFStack.push(callSpread(res.first - res.second));
+        };
+        void visitSupEqual(const NodeSupEqual &node) override
+        {
+            reverseVisitArguments(node);
+            auto res = pop2();
+            myFStack.push(callSpread(res.first - res.second));
+        };
+        void visitInferior(const NodeInferior &node) override
+        {
+            reverseVisitArguments(node);
+            auto res = pop2();
+            myFStack.push(callSpread(res.second - res.first));
+        };
+        void visitInfEqual(const NodeInfEqual &node) override
+        {
+            reverseVisitArguments(node);
+            auto res = pop2();
+            myFStack.push(callSpread(res.second - res.first));
+        };
+        void visitAnd(const NodeAnd &node) override
+        {
+            reverseVisitArguments(node);
+            auto res = pop2f();
+            myFStack.push(res.first * res.second);
+        };
+        void visitOr(const NodeOr &node) override
+        {
+            reverseVisitArguments(node);
+            auto res = pop2f();
+            myFStack.push(res.first + res.second - res.first * res.second);
+        };
+
+        void visitIf(const NodeIf &node) override
+        {
+            node.arguments[0]->acceptVisitor(*this);
+            const T dt = myFStack.top();
+            myFStack.pop();
+            const size_t lastTrue = node.firstElse == -1 ? node.arguments.size() - 1 : node.firstElse - 1;
+            const bool hasElse = node.firstElse != -1;
+
+            // Crisp outside the band, evaluate one branch as Evaluator does
+            if (dt == 1.0)
+            {
+                visitRange(node, 1, lastTrue);
+                return;
+            }
+            if (dt == 0.0)
+            {
+                if (hasElse)
+                    visitRange(node, node.firstElse, node.arguments.size() - 1);
+                return;
+            }
+
+            // Save, evaluate true, swap back, evaluate false, blend. Nested IFs stack above base
+            const auto &vars = node.affectedVars;
+            const size_t n = vars.size();
+            const size_t base = myStoreTop;
+            myStoreTop += 2 * n;
+            for (size_t k = 0; k < n; ++k)
+                myStore[base + k] = myVariables[vars[k]];
+            visitRange(node, 1, lastTrue);
+            for (size_t k = 0; k < n; ++k)
+            {
+                myStore[base + n + k] = myVariables[vars[k]];
+                myVariables[vars[k]] = myStore[base + k];
+            }
+            if (hasElse)
+                visitRange(node, node.firstElse, node.arguments.size() - 1);
+            for (size_t k = 0; k < n; ++k)
+                myVariables[vars[k]] = dt * myStore[base + n + k] + (1.0 - dt) * myVariables[vars[k]];
+            myStoreTop = base;
+        };
+    };
+}
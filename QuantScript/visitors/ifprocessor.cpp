@@ -0,0 +1,25 @@
+#include "ifprocessor.h"
+
+namespace QuantScript {
+    void IfProcessor::assigned(const Node& node) {
+        if (!myVarStack.empty()) {
+            myVarStack.back().insert(static_cast<const NodeVar&>(*node.arguments[0]).index);
+        };
+    };
+    void IfProcessor::visitIf(NodeIf& node) {
+        myVarStack.emplace_back();
+        visitArguments(node);
+        node.affectedVars.assign(myVarStack.back().begin(), myVarStack.back().end());
+        myVarStack.pop_back();
+        // Whatever a nested IF assigns is also assigned by the enclosing one
+        if (!myVarStack.empty()) {
+            myVarStack.back().insert(node.affectedVars.begin(), node.affectedVars.end());
+        };
+    };
+    void IfProcessor::visitAssign(NodeAssign& node) {
+        assigned(node);
+    };
+    void IfProcessor::visitPays(NodePays& node) {
+        assigned(node);
+    };
+}
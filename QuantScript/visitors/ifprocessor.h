@@ -0,0 +1,22 @@
+#pragma once
+#include "visitor.h"
+#include <set>
+
+namespace QuantScript
+{
+    // Records in every NodeIf the variables assigned in its branches, nested IFs
+    // included. Variables must be indexed first. Needed by FuzzyEvaluator
+    class IfProcessor : public Visitor
+    {
+        // Variables assigned so far in the IFs being visited, innermost last
+        std::vector<std::set<size_t>> myVarStack;
+
+        void assigned(const Node &node);
+
+    public:
+        ~IfProcessor() {};
+        void visitIf(NodeIf &node) override;
+        void visitAssign(NodeAssign &node) override;
+        void visitPays(NodePays &node) override;
+    };
+}
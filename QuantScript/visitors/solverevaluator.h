@@ -30,7 +30,8 @@ namespace QuantScript {
 	class SolverEvaluator : public Visitor {
 		std::string targetVariable;
 		T targetValue;
-		T* solverValue;
+		// Every SOLVE() node of the visited events
+		std::vector<T*> solverValues;
 		int targetIndex;
 
 	public:		
@@ -41,10 +42,11 @@ namespace QuantScript {
 			targetIndex = getIndex(varNames, targetVariable);
 		};
 		void update(T value) {
-			*solverValue = value;
+			for (T* v : solverValues)
+				*v = value;
 		};
 		void visitSolver(NodeSolver& node) {
-			solverValue = &node.value;
+			solverValues.push_back(&node.value);
 		};
 
 		//setters, getters
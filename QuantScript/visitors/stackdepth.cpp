@@ -0,0 +1,142 @@
+#include "stackdepth.h"
+#include <algorithm>
+
+namespace QuantScript
+{
+    // Unary nodes (+, -, LOG, SQRT) replace the top in place and keep the
+    // default visitArguments, which leaves the depth unchanged.
+    void StackDepth::push(size_t n)
+    {
+        myDepth += n;
+        myMaxDepth = std::max(myMaxDepth, myDepth);
+    };
+    void StackDepth::pushBool()
+    {
+        ++myBDepth;
+        myMaxBDepth = std::max(myMaxBDepth, myBDepth);
+    };
+    void StackDepth::reduce(const Node &node)
+    {
+        // Arguments are evaluated right to left and stay on the stack until all are done
+        for (auto it = node.arguments.rbegin(); it != node.arguments.rend(); ++it)
+            (*it)->acceptVisitor(*this);
+        myDepth -= node.arguments.size() - 1;
+    };
+    void StackDepth::compare(const Node &node)
+    {
+        for (auto it = node.arguments.rbegin(); it != node.arguments.rend(); ++it)
+            (*it)->acceptVisitor(*this);
+        myDepth -= 2;
+        pushBool();
+    };
+
+    void StackDepth::visitAdd(const NodeAdd &node)
+    {
+        reduce(node);
+    };
+    void StackDepth::visitSubtract(const NodeSubtract &node)
+    {
+        reduce(node);
+    };
+    void StackDepth::visitMult(const NodeMult &node)
+    {
+        reduce(node);
+    };
+    void StackDepth::visitDiv(const NodeDiv &node)
+    {
+        reduce(node);
+    };
+    void StackDepth::visitPow(const NodePow &node)
+    {
+        reduce(node);
+    };
+    void StackDepth::visitMax(const NodeMax &node)
+    {
+        reduce(node);
+    };
+    void StackDepth::visitMin(const NodeMin &node)
+    {
+        reduce(node);
+    };
+
+    void StackDepth::visitAssign(const NodeAssign &node)
+    {
+        node.arguments[1]->acceptVisitor(*this);
+        --myDepth;
+    };
+    void StackDepth::visitEqual(const NodeEqual &node)
+    {
+        compare(node);
+    };
+    void StackDepth::visitDifferent(const NodeDifferent &node)
+    {
+        compare(node);
+    };
+    void StackDepth::visitSuperior(const NodeSuperior &node)
+    {
+        compare(node);
+    };
+    void StackDepth::visitSupEqual(const NodeSupEqual &node)
+    {
+        compare(node);
+    };
+    void StackDepth::visitInferior(const NodeInferior &node)
+    {
+        compare(node);
+    };
+    void StackDepth::visitInfEqual(const NodeInfEqual &node)
+    {
+        compare(node);
+    };
+    void StackDepth::visitAnd(const NodeAnd &node)
+    {
+        for (auto it = node.arguments.rbegin(); it != node.arguments.rend(); ++it)
+            (*it)->acceptVisitor(*this);
+        --myBDepth;
+    };
+    void StackDepth::visitOr(const NodeOr &node)
+    {
+        for (auto it = node.arguments.rbegin(); it != node.arguments.rend(); ++it)
+            (*it)->acceptVisitor(*this);
+        --myBDepth;
+    };
+
+    void StackDepth::visitIf(const NodeIf &node)
+    {
+        // Both branches are replayed, the maximum covers whichever is taken
+        node.arguments[0]->acceptVisitor(*this);
+        --myBDepth;
+        // A blended IF saves the original and true-branch values of its variables
+        myStore += 2 * node.affectedVars.size();
+        myMaxStore = std::max(myMaxStore, myStore);
+        for (size_t i = 1; i < node.arguments.size(); ++i)
+            node.arguments[i]->acceptVisitor(*this);
+        myStore -= 2 * node.affectedVars.size();
+    };
+    void StackDepth::visitSpot(const NodeSpot &node)
+    {
+        push();
+    };
+    void StackDepth::visitConst(const NodeConst &node)
+    {
+        push();
+    };
+    void StackDepth::visitVar(const NodeVar &node)
+    {
+        push();
+    };
+    void StackDepth::visitPays(const NodePays &node)
+    {
+        node.arguments[1]->acceptVisitor(*this);
+        --myDepth;
+    };
+
+    void StackDepth::visitSolver(const NodeSolver &node)
+    {
+        push();
+    };
+    void StackDepth::visitDefinition(const NodeDefinition &node)
+    {
+        push();
+    };
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "visitor.h"
+
+namespace QuantScript
+{
+    // Maximum depth of the numeric and boolean stacks of Evaluator<T> over a
+    // product, found by replaying its push/pop sequence without evaluating,
+    // and of the store FuzzyEvaluator<T> blends nested IFs in.
+    class StackDepth : public ConstVisitor
+    {
+        size_t myDepth = 0;
+        size_t myBDepth = 0;
+        size_t myMaxDepth = 0;
+        size_t myMaxBDepth = 0;
+        size_t myStore = 0;
+        size_t myMaxStore = 0;
+
+        void push(size_t n = 1);
+        void pushBool();
+        void reduce(const Node &node);
+        void compare(const Node &node);
+
+    public:
+        ~StackDepth() {};
+        size_t maxDepth() const { return myMaxDepth; };
+        size_t maxBoolDepth() const { return myMaxBDepth; };
+        // Values saved by the blended IFs of the deepest nest, IFs must have been processed
+        size_t maxFuzzyStore() const { return myMaxStore; };
+
+        void visitAdd(const NodeAdd &node) override;
+        void visitSubtract(const NodeSubtract &node) override;
+        void visitMult(const NodeMult &node) override;
+        void visitDiv(const NodeDiv &node) override;
+        void visitPow(const NodePow &node) override;
+        void visitMax(const NodeMax &node) override;
+        void visitMin(const NodeMin &node) override;
+
+        void visitAssign(const NodeAssign &node) override;
+        void visitEqual(const NodeEqual &node) override;
+        void visitDifferent(const NodeDifferent &node) override;
+        void visitSuperior(const NodeSuperior &node) override;
+        void visitSupEqual(const NodeSupEqual &node) override;
+        void visitInferior(const NodeInferior &node) override;
+        void visitInfEqual(const NodeInfEqual &node) override;
+        void visitAnd(const NodeAnd &node) override;
+        void visitOr(const NodeOr &node) override;
+
+        void visitIf(const NodeIf &node) override;
+        void visitSpot(const NodeSpot &node) override;
+        void visitConst(const NodeConst &node) override;
+        void visitVar(const NodeVar &node) override;
+        void visitPays(const NodePays &node) override;
+
+        void visitSolver(const NodeSolver &node) override;
+        void visitDefinition(const NodeDefinition &node) override;
+    };
+}
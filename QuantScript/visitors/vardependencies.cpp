@@ -0,0 +1,59 @@
+#include "vardependencies.h"
+#include <algorithm>
+
+namespace QuantScript {
+    void VarDependencies::addEvent(const Event& event) {
+        const size_t e = myReads.size();
+        myReads.emplace_back();
+        myWrites.emplace_back();
+        myDependents.emplace_back();
+        for (auto& s : event) {
+            s->acceptVisitor(*this);
+        };
+        for (size_t i = 0; i < e; ++i) {
+            const bool depends = std::any_of(myWrites[i].begin(), myWrites[i].end(), [&](size_t v) {
+                return myReads[e].count(v) || myWrites[e].count(v);
+            });
+            if (depends) {
+                myDependents[i].push_back(e);
+            };
+        };
+    };
+    std::vector<size_t> VarDependencies::affectedEvents(size_t event, const std::set<size_t>& changedVars) const {
+        std::vector<bool> affected(numEvents(), false);
+        affected[event] = true;
+        for (size_t j = event + 1; j < numEvents(); ++j) {
+            for (size_t v : changedVars) {
+                if (myReads[j].count(v) || myWrites[j].count(v)) {
+                    affected[j] = true;
+                    break;
+                };
+            };
+        };
+        // Dependents are later events, one forward sweep closes the set
+        std::vector<size_t> result;
+        for (size_t i = event; i < numEvents(); ++i) {
+            if (affected[i]) {
+                result.push_back(i);
+                for (size_t j : myDependents[i]) {
+                    affected[j] = true;
+                };
+            };
+        };
+        return result;
+    };
+    void VarDependencies::written(const Node& node) {
+        myWrites.back().insert(static_cast<const NodeVar&>(*node.arguments[0]).index);
+    };
+    void VarDependencies::visitAssign(const NodeAssign& node) {
+        written(node);
+        node.arguments[1]->acceptVisitor(*this);
+    };
+    void VarDependencies::visitPays(const NodePays& node) {
+        written(node);
+        visitArguments(node);
+    };
+    void VarDependencies::visitVar(const NodeVar& node) {
+        myReads.back().insert(node.index);
+    };
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "visitor.h"
+#include <set>
+
+namespace QuantScript
+{
+    // Variables read and written by each event of a product and the dependency DAG between
+    // events: a later event depends on an earlier one when it reads or writes a variable the
+    // earlier one writes. PAYS reads its variable, writes under an IF count as writes.
+    // Variables must be indexed
+    class VarDependencies : public ConstVisitor
+    {
+        std::vector<std::set<size_t>> myReads;
+        std::vector<std::set<size_t>> myWrites;
+        // Per event, the later events depending on it
+        std::vector<std::vector<size_t>> myDependents;
+
+        void written(const Node &node);
+
+    public:
+        ~VarDependencies() {};
+        // Append the next event of the product
+        void addEvent(const Event &event);
+
+        size_t numEvents() const { return myReads.size(); };
+        const std::set<size_t> &reads(size_t event) const { return myReads[event]; };
+        const std::set<size_t> &writes(size_t event) const { return myWrites[event]; };
+        const std::vector<size_t> &dependents(size_t event) const { return myDependents[event]; };
+        // Events whose results may change when event changes, in order: event itself, the later
+        // events reading or writing one of changedVars and everything depending on those
+        std::vector<size_t> affectedEvents(size_t event, const std::set<size_t> &changedVars = {}) const;
+
+        void visitAssign(const NodeAssign &node) override;
+        void visitPays(const NodePays &node) override;
+        void visitVar(const NodeVar &node) override;
+    };
+}
@@ -0,0 +1,42 @@
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include "product/product.h"
+#include "product/aadval.h"
+#include "models/mrg32k3a.h"
+
+namespace QuantScript {
+	// Paths per second and risks of the target variable of a script with path-wise AAD,
+	// on one thread and then on the ThreadPool with 1 to maxThreads threads (caller included)
+	inline void bench_aad(const std::map<Date, std::string>& events, const std::string& target,
+		const unsigned numSim = 100000, const size_t maxThreads = 64) {
+		Date today(1, QuantLib::January, 2020);
+		Product prd;
+		prd.parseEvents(events.begin(), events.end());
+		prd.indexVariables();
+		SimpleBlackScholes<Number> model(today, Number(100.0), Number(0.2), Number(0.03));
+		Mrg32k3aGen random;
+
+		auto report = [&](const std::string& label, const ScriptRisks& risks, const double time) {
+			std::cout << label << numSim / time << " paths/s, " << target << " = " << risks.values[targetIndex(prd, target)];
+			for (size_t j = 0; j < risks.risks.size(); ++j)
+				std::cout << ", d/d" << risks.parameterLabels[j] << " = " << risks.risks[j];
+			std::cout << std::endl;
+		};
+
+		auto start = std::chrono::steady_clock::now();
+		auto risks = scriptValAAD(prd, model, random, numSim, target);
+		report("sequential: ", risks, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+		ThreadPool* pool = ThreadPool::getInstance();
+		for (size_t nThread = 1; nThread <= maxThreads; nThread *= 2) {
+			pool->stop();
+			pool->start(nThread - 1);
+			start = std::chrono::steady_clock::now();
+			risks = parallelScriptValAAD(prd, model, random, numSim, target);
+			report(std::to_string(nThread) + " threads: ", risks, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+		pool->stop();
+	};
+}
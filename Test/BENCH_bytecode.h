@@ -0,0 +1,127 @@
+#include <map>
+#include <chrono>
+#include <iostream>
+#include "product/product.h"
+
+namespace QuantScript {
+	// Monthly autocallable-style script used by the benchmarks
+	inline std::map<Date, std::string> bench_events(const Date& today) {
+		std::map<Date, std::string> events;
+		for (int m = 1; m <= 12; ++m) {
+			events[today + 30 * m] =
+				"alive = 1 - knocked "
+				"if spot() > 120 { knocked = 1 } "
+				"if spot() < 80 then if alive > 0.5 then put pays 100 - spot() endif else put = put + 0 endif "
+				"cpn pays alive * max(spot() / 100 - 1, 0) * 0.25";
+		}
+		return events;
+	};
+
+	// Paths per second of the visitor evaluator against the bytecode interpreter
+	// Scenarios are simulated upfront so that only the evaluation is timed
+	template <class T>
+	void bench_bytecode(const unsigned numSim = 100000) {
+		Date today(1, QuantLib::January, 2020);
+		auto events = bench_events(today);
+		Product prd;
+		prd.parseEvents(events.begin(), events.end());
+		prd.indexVariables();
+		prd.compile();
+
+		BasicRanGen random;
+		SimpleBlackScholes<T> model(today, 100.0, 0.2, 0.03);
+		ScriptSimulator<T> simulator(model, random);
+		simulator.initForScripting(prd.eventDates());
+		const size_t numScen = 1024;
+		std::vector<Scenario<T>> scenarios(numScen, Scenario<T>(prd.eventDates().size()));
+		for (auto& scen : scenarios)
+			simulator.nextScenario(scen);
+
+		auto visitorEval = prd.buildEvaluator<T>();
+		auto bytecodeEval = prd.buildBytecodeEvaluator<T>();
+		std::vector<T> visitorVals(prd.varNames().size(), 0.0), bytecodeVals(prd.varNames().size(), 0.0);
+
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < numSim; ++i) {
+			visitorEval->init();
+			prd.evaluate(scenarios[i % numScen], *visitorEval);
+			auto vals = visitorEval->varVals();
+			for (size_t v = 0; v < vals.size(); ++v) visitorVals[v] += vals[v] / numSim;
+		}
+		const double visitorTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < numSim; ++i) {
+			bytecodeEval->init();
+			prd.evaluate(scenarios[i % numScen], *bytecodeEval);
+			auto vals = bytecodeEval->varVals();
+			for (size_t v = 0; v < vals.size(); ++v) bytecodeVals[v] += vals[v] / numSim;
+		}
+		const double bytecodeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << "instructions: " << prd.program().instructions.size()
+			<< ", registers: " << prd.program().numRegisters << std::endl;
+		std::cout << "visitor:  " << numSim / visitorTime << " paths/s" << std::endl;
+		std::cout << "bytecode: " << numSim / bytecodeTime << " paths/s" << std::endl;
+		auto names = prd.varNames();
+		for (size_t v = 0; v < names.size(); ++v) {
+			std::cout << names[v] << ": " << visitorVals[v] << " / " << bytecodeVals[v] << std::endl;
+		}
+	};
+
+	// Paths per second of the scalar interpreter against the N-lane batch interpreter
+	template <size_t N>
+	void bench_batch(const unsigned numSim = 100000) {
+		Date today(1, QuantLib::January, 2020);
+		auto events = bench_events(today);
+		Product prd;
+		prd.parseEvents(events.begin(), events.end());
+		prd.indexVariables();
+		prd.compile();
+
+		BasicRanGen random;
+		SimpleBlackScholes<double> model(today, 100.0, 0.2, 0.03);
+		ScriptSimulator<double> simulator(model, random);
+		simulator.initForScripting(prd.eventDates());
+		const size_t numScen = 1024;
+		std::vector<Scenario<double>> scenarios(numScen, Scenario<double>(prd.eventDates().size()));
+		for (auto& scen : scenarios)
+			simulator.nextScenario(scen);
+		std::vector<std::unique_ptr<ScenarioBatch<N>>> batches(numScen / N);
+		for (size_t i = 0; i < batches.size(); ++i) {
+			batches[i] = prd.buildScenarioBatch<N>();
+			for (size_t l = 0; l < N; ++l)
+				batches[i]->set(l, scenarios[i * N + l]);
+		}
+
+		const size_t nVar = prd.varNames().size();
+		auto scalarEval = prd.buildBytecodeEvaluator<double>();
+		std::vector<double> scalarVals(nVar, 0.0), batchVals(nVar, 0.0);
+		const unsigned numBatch = numSim / N;
+
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < numBatch * N; ++i) {
+			scalarEval->init();
+			prd.evaluate(scenarios[i % numScen], *scalarEval);
+			auto vals = scalarEval->varVals();
+			for (size_t v = 0; v < nVar; ++v) scalarVals[v] += vals[v];
+		}
+		const double scalarTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		auto batchEval = prd.buildBatchEvaluator<N>();
+		start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < numBatch; ++i) {
+			batchEval->init();
+			prd.evaluate(*batches[i % batches.size()], *batchEval);
+			batchEval->sumVarVals(batchVals);
+		}
+		const double batchTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << "scalar:      " << numBatch * N / scalarTime << " paths/s" << std::endl;
+		std::cout << "batch (" << N << "): " << numBatch * N / batchTime << " paths/s" << std::endl;
+		auto names = prd.varNames();
+		for (size_t v = 0; v < nVar; ++v) {
+			std::cout << names[v] << ": " << scalarVals[v] / (numBatch * N) << " / " << batchVals[v] / (numBatch * N) << std::endl;
+		}
+	};
+}
@@ -0,0 +1,31 @@
+#include <iostream>
+#include <map>
+#include <string>
+#include "product/product.h"
+#include "product/aadval.h"
+#include "models/mrg32k3a.h"
+
+namespace QuantScript {
+	// Path-wise AAD risks of the target variable of a script with crisp and with fuzzy
+	// conditions, for increasing numbers of paths. Crisp greeks of digitals and barriers
+	// are zero path by path, fuzzy ones converge to the smoothed greeks
+	inline void bench_fuzzy(const std::map<Date, std::string>& events, const std::string& target,
+		const double eps = 1.0, const unsigned maxSim = 100000) {
+		Date today(1, QuantLib::January, 2020);
+		Product prd;
+		prd.parseEvents(events.begin(), events.end());
+		prd.indexVariables();
+		SimpleBlackScholes<Number> model(today, Number(100.0), Number(0.2), Number(0.03));
+		Mrg32k3aGen random;
+		const size_t idx = targetIndex(prd, target);
+
+		for (unsigned numSim = 1000; numSim <= maxSim; numSim *= 10) {
+			const ScriptRisks crisp = scriptValAAD(prd, model, random, numSim, target);
+			const ScriptRisks fuzzy = scriptValAAD(prd, model, random, numSim, target, eps);
+			std::cout << numSim << " paths: " << target << " = " << crisp.values[idx] << " / " << fuzzy.values[idx];
+			for (size_t j = 0; j < crisp.risks.size(); ++j)
+				std::cout << ", d/d" << crisp.parameterLabels[j] << " = " << crisp.risks[j] << " / " << fuzzy.risks[j];
+			std::cout << std::endl;
+		}
+	};
+}
@@ -0,0 +1,50 @@
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "parser/macros.h"
+#include "legacymacros.h"
+
+namespace QuantScript {
+	// Term sheet macros: constants and payoff functions, some nested
+	inline std::map<std::string, std::string> bench_macros(const unsigned numMacros) {
+		std::map<std::string, std::string> macros;
+		for (unsigned i = 0; i < numMacros; ++i) {
+			macros["STRIKE" + std::to_string(i)] = std::to_string(90 + i % 20);
+			macros["NOTIONAL" + std::to_string(i)] = std::to_string(1000 * (i + 1));
+		}
+		macros["CALL(S,K)"] = "MAX(S - K, 0)";
+		macros["PUT(S,K)"] = "MAX(K - S, 0)";
+		macros["STRADDLE(S,K)"] = "CALL(S, K) + PUT(S, K)";
+		return macros;
+	};
+
+	// Macro expansion of the regex replacer against the token-level table, over many trades
+	inline void bench_macro_expansion(const unsigned numTrades = 1000, const unsigned numMacros = 50) {
+		const auto macros = bench_macros(numMacros);
+		std::vector<std::string> scripts(numTrades);
+		for (unsigned t = 0; t < numTrades; ++t) {
+			const std::string k = std::to_string(t % numMacros);
+			scripts[t] = "opt pays NOTIONAL" + k + " * STRADDLE(SPOT(), STRIKE" + k + ") / STRIKE" + k +
+				" if spot() > STRIKE" + k + " then dig pays NOTIONAL" + k + " endif";
+		}
+
+		size_t bytes = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (auto& script : scripts)
+			bytes += legacyMacroReplacer(macros, script).size();
+		const double legacyTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		start = std::chrono::steady_clock::now();
+		MacroTable table(macros);
+		size_t tokens = 0;
+		for (auto& script : scripts)
+			tokens += table.expandTokens(script).size();
+		const double tableTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << "expanded " << bytes << " bytes, " << tokens << " tokens" << std::endl;
+		std::cout << "regex:  " << numTrades / legacyTime << " trades/s" << std::endl;
+		std::cout << "table:  " << numTrades / tableTime << " trades/s" << std::endl;
+	};
+}
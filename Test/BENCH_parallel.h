@@ -0,0 +1,43 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "product/product.h"
+#include "product/parallelval.h"
+#include "models/mrg32k3a.h"
+
+namespace QuantScript {
+	// Paths per second of parallelScriptVal on 1 to maxThreads threads (caller included),
+	// and whether every run reproduces the single-threaded result bit for bit
+	inline void bench_parallel(const std::map<Date, std::string>& events, const unsigned numSim = 200000, const size_t maxThreads = 64) {
+		Date today(1, QuantLib::January, 2020);
+		Product prd;
+		prd.parseEvents(events.begin(), events.end());
+		prd.indexVariables();
+		SimpleBlackScholes<double> model(today, 100.0, 0.2, 0.03);
+		Mrg32k3aGen random;
+
+		ThreadPool* pool = ThreadPool::getInstance();
+		std::vector<double> reference;
+		double baseTime = 0.0;
+		for (size_t nThread = 1; nThread <= maxThreads; nThread *= 2) {
+			pool->stop();
+			pool->start(nThread - 1);
+			auto start = std::chrono::steady_clock::now();
+			const std::vector<double> vals = parallelScriptVal(prd, model, random, numSim).means();
+			const double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (nThread == 1) {
+				reference = vals;
+				baseTime = time;
+			}
+			const bool same = std::memcmp(vals.data(), reference.data(), vals.size() * sizeof(double)) == 0;
+			std::cout << nThread << " threads: " << numSim / time << " paths/s, speedup " << baseTime / time
+				<< (same ? ", identical" : ", DIFFERENT") << std::endl;
+		}
+		pool->stop();
+		auto names = prd.varNames();
+		for (size_t v = 0; v < names.size(); ++v) {
+			std::cout << names[v] << ": " << reference[v] << std::endl;
+		}
+	};
+}
@@ -0,0 +1,51 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "legacyparser.h"
+
+namespace QuantScript {
+	// Scripted trades as loaded at start of day, one string per event
+	inline std::vector<std::vector<std::string>> bench_trades(const unsigned numTrades) {
+		std::vector<std::vector<std::string>> trades(numTrades);
+		for (unsigned t = 0; t < numTrades; ++t) {
+			const std::string strike = std::to_string(80 + t % 40);
+			const std::string barrier = std::to_string(110 + t % 30) + ".5";
+			for (int m = 1; m <= 12; ++m) {
+				trades[t].push_back(
+					"alive = 1 - knocked "
+					"if spot() > " + barrier + " then knocked = 1 endif "
+					"if spot() < " + strike + " then if alive > 0.5 then put pays " + strike + " - spot() endif else put = put + 0 endif "
+					"cpn pays alive * max(spot() / " + strike + " - 1, 0) * 0.25");
+			}
+		}
+		return trades;
+	};
+
+	// Parse throughput of the regex tokenizer and string parser against the lexer-based parser
+	inline void bench_parse(const unsigned numTrades = 10000) {
+		auto trades = bench_trades(numTrades);
+		size_t bytes = 0, nodes = 0;
+		for (auto& trade : trades)
+			for (auto& event : trade)
+				bytes += event.size();
+
+		auto start = std::chrono::steady_clock::now();
+		for (auto& trade : trades)
+			for (auto& event : trade)
+				nodes += parseLegacy(event).size();
+		const double legacyTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		start = std::chrono::steady_clock::now();
+		for (auto& trade : trades)
+			for (auto& event : trade)
+				nodes -= parse(event).size();
+		const double lexerTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (nodes != 0)
+			std::cout << "statement counts differ" << std::endl;
+		const double mb = bytes / 1.0e6;
+		std::cout << "regex:  " << mb / legacyTime << " MB/s, " << numTrades / legacyTime << " trades/s" << std::endl;
+		std::cout << "lexer:  " << mb / lexerTime << " MB/s, " << numTrades / lexerTime << " trades/s" << std::endl;
+	};
+}
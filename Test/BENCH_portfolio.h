@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <map>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "product/product.h"
+#include "product/portfolio.h"
+
+namespace QuantScript {
+	// Book of vanilla and barrier trades on one underlying, quarterly or annual events
+	inline std::vector<std::map<Date, std::string>> bench_book(const Date& today, const unsigned numTrades) {
+		std::vector<std::map<Date, std::string>> book(numTrades);
+		for (unsigned t = 0; t < numTrades; ++t) {
+			const std::string k = std::to_string(80 + t % 40);
+			const int step = t % 2 ? 90 : 360;
+			for (int d = step; d <= 720; d += step)
+				book[t][today + d] = "if spot() < " + k + " - 20 then ko = 1 endif";
+			book[t][today + 720] += " opt pays (1 - ko) * max(spot() - " + k + ", 0)";
+		}
+		return book;
+	};
+
+	// Time of valuing each trade on its own simulation against one shared Portfolio simulation
+	inline void bench_portfolio(const unsigned numTrades = 500, const unsigned numSim = 2000) {
+		Date today(1, QuantLib::January, 2020);
+		auto book = bench_book(today, numTrades);
+
+		auto start = std::chrono::steady_clock::now();
+		double standalone = 0.0;
+		for (auto& events : book) {
+			Product prd;
+			prd.parseEvents(events.begin(), events.end());
+			prd.indexVariables();
+			BasicRanGen random;
+			SimpleBlackScholes<double> model(today, 100.0, 0.2, 0.03);
+			ScriptSimulator<double> simulator(model, random);
+			simulator.initForScripting(prd.eventDates());
+			auto scen = prd.buildScenario<double>();
+			auto eval = prd.buildEvaluator<double>();
+			const auto names = prd.varNames();
+			const size_t opt = std::find(names.begin(), names.end(), "OPT") - names.begin();
+			for (unsigned i = 0; i < numSim; ++i) {
+				simulator.nextScenario(*scen);
+				eval->init();
+				prd.evaluate(*scen, *eval);
+				standalone += eval->variables()[opt] / numSim;
+			}
+		}
+		const double standaloneTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		start = std::chrono::steady_clock::now();
+		Portfolio portfolio;
+		for (auto& events : book) {
+			Product prd;
+			prd.parseEvents(events.begin(), events.end());
+			prd.indexVariables();
+			portfolio.add(std::move(prd));
+		}
+		BasicRanGen random;
+		SimpleBlackScholes<double> model(today, 100.0, 0.2, 0.03);
+		auto results = portfolio.value(model, random, numSim);
+		const double portfolioTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << "timeline: " << portfolio.timeline().size() << " dates for " << numTrades << " trades" << std::endl;
+		std::cout << "standalone: " << standaloneTime << " s, OPT = " << standalone << std::endl;
+		std::cout << "portfolio:  " << portfolioTime << " s, OPT = " << results.aggregate["OPT"] << std::endl;
+	};
+}
@@ -0,0 +1,144 @@
+#include <map>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include "product/product.h"
+#include "product/productarchive.h"
+
+namespace QuantScript {
+	// Writes flattened products to an archive, maps it back and checks that
+	// every product evaluates to bit-identical values on the same scenarios
+	inline bool test_archive_roundtrip(const std::string& path = "products.qsa") {
+		Date today(1, QuantLib::January, 2020);
+		std::vector<std::map<Date, std::string>> scripts = {
+			{ {today + 90, "x = 1.5 * spot() if x > 150 then y = log(x) - 0.25 else y = sqrt(x) endif"},
+			  {today + 180, "opt pays max(y - 4, 0) + min(x, 100) ^ 0.5"} },
+			{ {today + 30, "alive = 1 - knocked if spot() > 120 { knocked = 1 }"},
+			  {today + 60, "if spot() < 80 and alive > 0.5 then put pays 100 - spot() endif"} },
+		};
+
+		// Products loaded through the cache share one FlatAst per script, stored once
+		std::vector<Product> products;
+		for (int i = 0; i < 6; ++i) {
+			Product prd;
+			prd.loadEvents(scripts[i % 2].begin(), scripts[i % 2].end());
+			products.push_back(std::move(prd));
+		}
+		std::vector<const Product*> pointers;
+		for (auto& prd : products)
+			pointers.push_back(&prd);
+		ProductArchive::write(path, pointers);
+
+		bool ok = true;
+		{
+			ProductArchive archive(path);
+			ok = archive.size() == products.size() && archive.numDistinctScripts() == scripts.size();
+			BasicRanGen random;
+			for (size_t i = 0; ok && i < products.size(); ++i) {
+				Product loaded = archive.product(i);
+				ok = loaded.eventDates() == products[i].eventDates() && loaded.varNames() == products[i].varNames();
+				SimpleBlackScholes<double> model(today, 100.0, 0.2, 0.03);
+				ScriptSimulator<double> simulator(model, random);
+				simulator.initForScripting(products[i].eventDates());
+				auto scenario = products[i].buildScenario<double>();
+				auto original = products[i].buildFlatEvaluator<double>();
+				auto mapped = loaded.buildFlatEvaluator<double>();
+				for (int scen = 0; ok && scen < 1000; ++scen) {
+					simulator.nextScenario(*scenario);
+					original->init();
+					products[i].evaluate(*scenario, *original);
+					mapped->init();
+					loaded.evaluate(*scenario, *mapped);
+					const auto& a = original->varVals();
+					const auto& b = mapped->varVals();
+					ok = a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0;
+				}
+			}
+		}
+		std::remove(path.c_str());
+		std::cout << "archive round trip: " << (ok ? "OK" : "FAILED") << std::endl;
+		return ok;
+	};
+
+	// Corrupts one node of an archived script at a time: an else position past the
+	// children of an If, an assignment to a constant, an assignment without children, a
+	// product with one argument, a node that is its own child, a constant as a condition
+	// and a condition assigned as a value, and checks that mapping
+	// the archive throws instead of handing the evaluator links it would follow blindly
+	inline bool test_archive_corrupt(const std::string& path = "corrupt.qsa") {
+		Date today(1, QuantLib::January, 2020);
+		std::map<Date, std::string> script = { {today + 90, "x = 1.5 * spot() if x > 150 then y = 1 else y = 2 endif"} };
+		Product prd;
+		prd.parseEvents(script.begin(), script.end());
+		prd.indexVariables();
+		prd.flatten();
+		ProductArchive::write(path, { &prd });
+		std::string bytes;
+		{
+			std::ifstream in(path, std::ios::binary);
+			bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		}
+
+		// The first AST record follows the 32-byte header, its nodes follow the record and its events
+		uint64_t record;
+		std::memcpy(&record, &bytes[32], sizeof(record));
+		uint32_t numNodes, numEvents;
+		std::memcpy(&numNodes, &bytes[record], sizeof(numNodes));
+		std::memcpy(&numEvents, &bytes[record + 8], sizeof(numEvents));
+		const size_t nodes = record + 24 + numEvents * sizeof(FlatAst::EventRange);
+		auto node = [&](const std::string& file, uint32_t i) {
+			FlatNode n;
+			std::memcpy(&n, &file[nodes + i * sizeof(FlatNode)], sizeof(n));
+			return n;
+		};
+		auto find = [&](NodeKind kind) {
+			for (uint32_t i = 0; i < numNodes; ++i)
+				if (node(bytes, i).kind == kind)
+					return i;
+			return numNodes;
+		};
+		auto rejected = [&](uint32_t i, const std::function<void(FlatNode&, std::string&)>& corrupt) {
+			std::string file = bytes;
+			FlatNode n = node(file, i);
+			corrupt(n, file);
+			std::memcpy(&file[nodes + i * sizeof(FlatNode)], &n, sizeof(n));
+			{
+				std::ofstream out(path, std::ios::binary | std::ios::trunc);
+				out.write(file.data(), std::streamsize(file.size()));
+			}
+			try {
+				ProductArchive archive(path);
+			}
+			catch (const std::runtime_error&) {
+				return true;
+			}
+			return false;
+		};
+
+		const uint32_t ifNode = find(NodeKind::If), assign = find(NodeKind::Assign), mult = find(NodeKind::Mult),
+			superior = find(NodeKind::Superior);
+		bool ok = ifNode < numNodes && assign < numNodes && mult < numNodes && superior < numNodes;
+		ok = ok && !rejected(ifNode, [](FlatNode&, std::string&) {});
+		ok = ok && rejected(ifNode, [](FlatNode& n, std::string&) { n.data = n.count + 1; });
+		ok = ok && rejected(assign, [&](FlatNode& n, std::string& file) {
+			// The assigned variable becomes constant 0
+			FlatNode target = node(file, n.first);
+			target.kind = NodeKind::Const;
+			target.data = 0;
+			std::memcpy(&file[nodes + n.first * sizeof(FlatNode)], &target, sizeof(target));
+		});
+		ok = ok && rejected(assign, [&](FlatNode& n, std::string&) { n.first = numNodes; n.count = 0; });
+		ok = ok && rejected(mult, [](FlatNode& n, std::string&) { n.count = 1; });
+		ok = ok && rejected(mult, [&](FlatNode& n, std::string&) { n.first = mult; });
+		// A constant leaf as the condition of the If, the evaluator would test its missing children
+		ok = ok && rejected(superior, [&](FlatNode& n, std::string&) { n = { NodeKind::Const, numNodes, 0, 0 }; });
+		// A condition assigned as a value
+		ok = ok && rejected(mult, [](FlatNode& n, std::string&) { n.kind = NodeKind::Superior; });
+		std::remove(path.c_str());
+		std::cout << "corrupt archive: " << (ok ? "rejected" : "ACCEPTED") << std::endl;
+		return ok;
+	};
+}
@@ -0,0 +1,43 @@
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include "product/product.h"
+
+namespace QuantScript {
+	// Compiles a script reading SOLVE(), then flattens it: the program read the SOLVE()
+	// value from the released nodes, so building a bytecode evaluator and compiling again
+	// must throw, while the flat evaluator still values the script
+	inline bool test_flatten_drops_program() {
+		Date today(1, QuantLib::January, 2020);
+		std::map<Date, std::string> events = { {today + 90, "x = SOLVE() + spot()"} };
+		Product prd;
+		prd.parseEvents(events.begin(), events.end());
+		prd.indexVariables();
+		prd.compile();
+		bool ok = prd.buildBytecodeEvaluator<double>() != nullptr;
+		prd.flatten();
+
+		auto throws = [](auto f) {
+			try {
+				f();
+			}
+			catch (const std::runtime_error&) {
+				return true;
+			}
+			return false;
+		};
+		ok = ok && throws([&]() { prd.buildBytecodeEvaluator<double>(); }) &&
+			throws([&]() { prd.buildBatchEvaluator<4>(); }) && throws([&]() { prd.compile(); });
+
+		Scenario<double> scenario(1);
+		scenario.spot(0) = 100.0;
+		scenario.numeraire(0) = 1.0;
+		auto flat = prd.buildFlatEvaluator<double>();
+		flat->setSolverValue(0, 5.0);
+		flat->init();
+		prd.evaluate(scenario, *flat);
+		ok = ok && flat->variables()[0] == 105.0;
+		std::cout << "flatten after compile: " << (ok ? "OK" : "FAILED") << std::endl;
+		return ok;
+	};
+}
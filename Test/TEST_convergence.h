@@ -0,0 +1,47 @@
+#include <iostream>
+#include <map>
+#include "product/product.h"
+#include "product/parallelval.h"
+#include "models/mrg32k3a.h"
+
+namespace QuantScript {
+	// Prices a call to a 1% relative standard error and checks that the run stops on the
+	// tolerance, meets it, and matches parallelScriptVal over the same paths bit for bit.
+	// Then checks that a run without tolerance stops on maxPaths, and on an expired deadline
+	inline bool test_convergence() {
+		Date today(1, QuantLib::January, 2020);
+		std::map<Date, std::string> events = { {today + 360, "opt pays max(spot() - 100, 0)"} };
+		Product prd;
+		prd.parseEvents(events.begin(), events.end());
+		prd.indexVariables();
+		SimpleBlackScholes<double> model(today, 100.0, 0.2, 0.03);
+		Mrg32k3aGen random;
+
+		ConvergenceSettings settings;
+		settings.targets = { "OPT" };
+		settings.relativeTolerance = 0.01;
+		const ConvergenceResult converged = convergentScriptVal(prd, model, random, settings);
+		const PathStatistics& stats = converged.statistics;
+		std::cout << "price " << stats.mean(0) << " +/- " << stats.standardError(0) << " over "
+			<< stats.count() << " paths in " << converged.seconds << "s" << std::endl;
+		const PathStatistics reference = parallelScriptVal(prd, model, random, stats.count());
+		bool ok = converged.stop == ConvergenceStop::Tolerance &&
+			stats.standardError(0) <= 0.01 * stats.mean(0) &&
+			stats.mean(0) == reference.mean(0) && stats.standardError(0) == reference.standardError(0);
+
+		ConvergenceSettings budget;
+		budget.maxPaths = 5000;
+		const ConvergenceResult capped = convergentScriptVal(prd, model, random, budget);
+		ok = ok && capped.stop == ConvergenceStop::MaxPaths && capped.statistics.count() == 5000;
+
+		budget.maxPaths = 10000000;
+		budget.deadline = 0.0;
+		const ConvergenceResult late = convergentScriptVal(prd, model, random, budget);
+		// Only the first round, rounded up to whole batches
+		ok = ok && late.stop == ConvergenceStop::Deadline && late.statistics.count() >= budget.minPaths &&
+			late.statistics.count() < budget.minPaths + SCRIPT_BATCHSIZE;
+
+		std::cout << "convergence " << (ok ? "OK" : "FAILED") << std::endl;
+		return ok;
+	};
+}
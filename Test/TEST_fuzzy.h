@@ -0,0 +1,74 @@
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <string>
+#include "product/product.h"
+#include "models/mrg32k3a.h"
+
+namespace QuantScript {
+	// Fuzzy values of a script on one scenario with spot 100.5 and a band of width 2, against
+	// degrees of truth computed by hand: 100.5 > 100 is 0.75, 100.5 < 101 is 0.75, their AND
+	// 0.5625, 100.5 = 100 is 0.5. Then a digital valued with crisp and fuzzy conditions on
+	// the same paths, whose difference must shrink as the band narrows
+	inline bool test_fuzzy(const unsigned numSim = 10000) {
+		Date today(1, QuantLib::January, 2020);
+		std::map<Date, std::string> events = { {today + 360,
+			"z = 10 "
+			"if spot() > 100 then a = 1 else a = 0 endif "
+			"if spot() > 100 and spot() < 101 then b = 1 endif "
+			"if spot() = 100 then c = 1 endif "
+			"if spot() > 100 then z = 20 if spot() < 101 then w = 4 endif endif"} };
+		Product prd;
+		prd.parseEvents(events.begin(), events.end());
+		prd.indexVariables();
+		prd.processIfs();
+		auto fuzzy = prd.buildFuzzyEvaluator<double>(2.0);
+		Scenario<double> scenario(1);
+		scenario.spot(0) = 100.5;
+		scenario.numeraire(0) = 1.0;
+		fuzzy->init();
+		prd.evaluate(scenario, *fuzzy);
+		std::map<std::string, double> expected = {
+			{"A", 0.75}, {"B", 0.5625}, {"C", 0.5}, {"Z", 0.75 * 20 + 0.25 * 10}, {"W", 0.75 * 0.75 * 4} };
+		const std::vector<std::string> names = prd.varNames();
+		bool ok = true;
+		for (size_t v = 0; v < names.size(); ++v)
+			ok = ok && std::fabs(fuzzy->variables()[v] - expected[names[v]]) < 1.0e-14;
+		std::cout << "fuzzy degrees " << (ok ? "match" : "DIFFER") << std::endl;
+
+		std::map<Date, std::string> digital = { {today + 360, "if spot() > 100 then dig pays 1 endif"} };
+		Product dig;
+		dig.parseEvents(digital.begin(), digital.end());
+		dig.indexVariables();
+		dig.processIfs();
+		SimpleBlackScholes<double> model(today, 100.0, 0.2, 0.03);
+		Mrg32k3aGen random;
+		ScriptSimulator<double> simulator(model, random);
+		simulator.initForScripting(dig.eventDates());
+		std::vector<Scenario<double>> paths(numSim, Scenario<double>(1));
+		for (auto& path : paths)
+			simulator.nextScenario(path);
+		auto crisp = dig.buildEvaluator<double>();
+		double crispValue = 0.0;
+		for (auto& path : paths) {
+			crisp->init();
+			dig.evaluate(path, *crisp);
+			crispValue += crisp->variables()[0] / numSim;
+		}
+		double previous = HUGE_VAL;
+		for (double eps = 1.0; eps > 1.0e-3; eps /= 10.0) {
+			auto smooth = dig.buildFuzzyEvaluator<double>(eps);
+			double value = 0.0;
+			for (auto& path : paths) {
+				smooth->init();
+				dig.evaluate(path, *smooth);
+				value += smooth->variables()[0] / numSim;
+			}
+			const double error = std::fabs(value - crispValue);
+			std::cout << "eps " << eps << ": fuzzy " << value << " crisp " << crispValue << std::endl;
+			ok = ok && error <= previous;
+			previous = error;
+		}
+		return ok && previous < 1.0e-4;
+	};
+}
@@ -0,0 +1,57 @@
+#include <chrono>
+#include <iostream>
+#include <map>
+#include "product/product.h"
+#include "product/incremental.h"
+#include "models/pathstore.h"
+#include "models/mrg32k3a.h"
+
+namespace QuantScript {
+	// Edits events of a monthly autocallable-like script valued incrementally and checks every
+	// update against a full valuation of the edited script on the same paths. Every update must
+	// evaluate only the suffix from the edited event and cost less than the full valuation
+	inline bool test_incremental(const size_t numSim = 2000, const size_t numEvents = 60) {
+		Date today(1, QuantLib::January, 2020);
+		std::map<Date, std::string> events;
+		for (size_t e = 0; e < numEvents; ++e)
+			events[today + int(30 * (e + 1))] = e == 0 ? "ref = spot()" :
+				"if spot() > ref then cpn" + std::to_string(e) + " pays 0.01 endif acc = acc + spot() / ref";
+		std::vector<Date> dates;
+		for (auto& [date, script] : events)
+			dates.push_back(date);
+		SimpleBlackScholes<double> model(today, 100.0, 0.2, 0.03);
+		Mrg32k3aGen random;
+		const PathStore paths(model, random, dates, numSim);
+
+		Product prd;
+		prd.parseEvents(events.begin(), events.end());
+		prd.indexVariables();
+		IncrementalValuation valuation(prd, paths);
+
+		// Late coupon, new variable, then a change of the running accumulator
+		const std::vector<std::pair<size_t, std::string>> edits = {
+			{numEvents - 2, "if spot() > 1.05 * ref then cpn" + std::to_string(numEvents - 2) + " pays 0.02 endif acc = acc + spot() / ref"},
+			{numEvents - 1, "if spot() > ref then bonus pays 0.05 endif acc = acc + spot() / ref"},
+			{numEvents / 2, "acc = acc + 2 * spot() / ref"} };
+		bool ok = true;
+		for (auto& [i, script] : edits) {
+			auto start = std::chrono::steady_clock::now();
+			const size_t evaluated = valuation.replaceEvent(i, script);
+			const double incremental = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			std::next(events.begin(), i)->second = script;
+			Product full;
+			full.parseEvents(events.begin(), events.end());
+			full.indexVariables();
+			start = std::chrono::steady_clock::now();
+			IncrementalValuation reference(full, paths);
+			const double complete = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			ok = ok && reference.varNames() == valuation.varNames() && reference.values() == valuation.values() &&
+				evaluated <= numEvents - i && incremental < complete;
+			std::cout << "event " << i << ": " << evaluated << " of " << numEvents << " events evaluated, "
+				<< incremental << "s against " << complete << "s" << std::endl;
+		}
+		return ok;
+	};
+}
@@ -0,0 +1,101 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include "product/product.h"
+#include "product/parallelval.h"
+#include "models/pathstore.h"
+#include "models/mrg32k3a.h"
+
+namespace QuantScript {
+	// Values a script on paths simulated by the generator, on a PathStore in memory and on
+	// one written to path and mapped back, and checks that the three are bit-identical
+	inline bool test_pathstore(const std::string& path = "paths.qps", const size_t numSim = 10000) {
+		Date today(1, QuantLib::January, 2020);
+		std::map<Date, std::string> events = {
+			{today + 180, "x = spot()"},
+			{today + 360, "opt pays max(spot() - 0.5 * x - 50, 0)"} };
+		Product prd;
+		prd.parseEvents(events.begin(), events.end());
+		prd.indexVariables();
+		SimpleBlackScholes<double> model(today, 100.0, 0.2, 0.03);
+		Mrg32k3aGen random;
+
+		const std::vector<double> simulated = parallelScriptVal(prd, model, random, numSim).means();
+		const PathStore memory(model, random, prd.eventDates(), numSim);
+		const std::vector<double> inMemory = parallelScriptVal(prd, memory).means();
+		PathStore::write(path, model, random, prd.eventDates(), numSim);
+		bool ok;
+		{
+			const PathStore mapped(path);
+			ok = mapped.numPaths() == numSim && mapped.timeline() == prd.eventDates() &&
+				parallelScriptVal(prd, mapped).means() == simulated && inMemory == simulated;
+		}
+		std::remove(path.c_str());
+		std::cout << "path store " << (ok ? "identical" : "differs") << std::endl;
+		return ok;
+	};
+
+	// Unsorted timelines and path counts whose size overflows are refused, in memory and on
+	// write, and so are files whose header numbers of paths wrap around to the file size or
+	// whose dates are out of order
+	inline bool test_pathstore_rejects(const std::string& path = "rejects.qps") {
+		Date today(1, QuantLib::January, 2020);
+		SimpleBlackScholes<double> model(today, 100.0, 0.2, 0.03);
+		Mrg32k3aGen random;
+		const std::vector<Date> timeline = { today + 180, today + 360 };
+		const std::vector<Date> unsorted = { today + 360, today + 180 };
+		auto throws = [](const std::function<void()>& f) {
+			try {
+				f();
+			}
+			catch (const std::runtime_error&) {
+				return true;
+			}
+			return false;
+		};
+		const size_t tooMany = std::numeric_limits<size_t>::max() / 8;
+		bool ok = throws([&]() { PathStore(model, random, unsorted, 10); }) &&
+			throws([&]() { PathStore::write(path, model, random, unsorted, 10); }) &&
+			throws([&]() { PathStore(model, random, timeline, tooMany); }) &&
+			throws([&]() { PathStore::write(path, model, random, timeline, tooMany); });
+
+		const size_t numSim = 100;
+		PathStore::write(path, model, random, timeline, numSim);
+		std::string bytes;
+		{
+			std::ifstream in(path, std::ios::binary);
+			bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		}
+		auto rejected = [&](const std::function<void(std::string&)>& corrupt) {
+			std::string file = bytes;
+			corrupt(file);
+			{
+				std::ofstream out(path, std::ios::binary | std::ios::trunc);
+				out.write(file.data(), std::streamsize(file.size()));
+			}
+			return throws([&]() { PathStore mapped(path); });
+		};
+		// numEvents and numPaths at offsets 16 and 24 of the header, dates from 32
+		ok = ok && rejected([](std::string& file) {
+			// 2 events take 32 bytes a path, 2^59 more paths wrap to the same size
+			const uint64_t numPaths = numSim + (uint64_t(1) << 59);
+			std::memcpy(&file[24], &numPaths, sizeof(numPaths));
+		});
+		ok = ok && rejected([](std::string& file) {
+			const uint64_t numEvents = uint64_t(1) << 62;
+			std::memcpy(&file[16], &numEvents, sizeof(numEvents));
+		});
+		ok = ok && rejected([](std::string& file) {
+			std::swap_ranges(&file[32], &file[36], &file[36]);
+		});
+		std::remove(path.c_str());
+		std::cout << "bad path stores " << (ok ? "rejected" : "ACCEPTED") << std::endl;
+		return ok;
+	};
+}
@@ -0,0 +1,77 @@
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "product/product.h"
+#include "product/portfolio.h"
+#include "models/pathstore.h"
+#include "models/mrg32k3a.h"
+
+namespace QuantScript {
+	// Values a book of trades on different dates as a Portfolio, one of them flattened, then
+	// each trade alone on the same paths read from a PathStore on the portfolio timeline.
+	// Per trade statistics must match bit for bit and the aggregate must be the sum of the means by name
+	inline bool test_portfolio(const unsigned numSim = 2000) {
+		Date today(1, QuantLib::January, 2020);
+		const std::vector<std::map<Date, std::string>> book = {
+			{ {today + 360, "opt pays max(spot() - 100, 0)"} },
+			{ {today + 90, "ref = spot()"}, {today + 270, "if spot() < 0.8 * ref then ko = 1 endif"},
+				{today + 360, "opt pays (1 - ko) * max(spot() - ref, 0)"} },
+			{ {today + 180, "if spot() > 105 then cpn pays 0.05 endif"}, {today + 360, "opt pays max(95 - spot(), 0)"} } };
+		auto build = [&](size_t t) {
+			Product prd;
+			prd.parseEvents(book[t].begin(), book[t].end());
+			prd.indexVariables();
+			if (t == 2)
+				prd.flatten();
+			return prd;
+		};
+
+		Portfolio portfolio;
+		for (size_t t = 0; t < book.size(); ++t)
+			portfolio.add(build(t));
+		SimpleBlackScholes<double> model(today, 100.0, 0.2, 0.03);
+		Mrg32k3aGen random;
+		const PortfolioResults<double> results = portfolio.value(model, random, numSim);
+
+		Mrg32k3aGen fresh;
+		const PathStore paths(model, fresh, portfolio.timeline(), numSim);
+		std::map<std::string, double> aggregate;
+		bool ok = true;
+		for (size_t t = 0; t < book.size(); ++t) {
+			Product prd = build(t);
+			StoredPathSimulator simulator(paths);
+			simulator.initForScripting(prd.eventDates());
+			auto scenario = prd.buildScenario<double>();
+			const std::vector<std::string> names = prd.varNames();
+			PathStatistics stats(names.size());
+			auto tree = prd.sharedFlat() ? nullptr : prd.buildEvaluator<double>();
+			auto flat = prd.sharedFlat() ? prd.buildFlatEvaluator<double>() : nullptr;
+			for (unsigned i = 0; i < numSim; ++i) {
+				simulator.nextScenario(*scenario);
+				const std::vector<double>* vals;
+				if (flat) {
+					flat->init();
+					prd.evaluate(*scenario, *flat);
+					vals = &flat->variables();
+				}
+				else {
+					tree->init();
+					prd.evaluate(*scenario, *tree);
+					vals = &tree->variables();
+				}
+				stats.add(*vals);
+			}
+			const PathStatistics& portfolioStats = results.statistics[t];
+			ok = ok && stats.means() == results.trades[t] && stats.count() == portfolioStats.count();
+			for (size_t v = 0; v < names.size(); ++v) {
+				ok = ok && stats.standardError(v) == portfolioStats.standardError(v);
+				aggregate[names[v]] += stats.mean(v);
+			}
+		}
+		ok = ok && aggregate == results.aggregate;
+		std::cout << "portfolio OPT " << results.aggregate.at("OPT") << ", trades alone on its paths "
+			<< (ok ? "match" : "DIFFER") << std::endl;
+		return ok;
+	};
+}
@@ -16,6 +16,8 @@ namespace QuantScript {
 		std::map<Date, std::string> mapping = { {1,s} };
 		Product prod;
 		prod.parseEvents(mapping.begin(), mapping.end());
+		// LOG(1+6-6) and the MAX around it fold to a constant
+		std::cout << "folded nodes: " << prod.foldConstants() << std::endl;
 		prod.indexVariables();
 		Debugger d;
 		prod.visit(d);
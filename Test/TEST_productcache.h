@@ -0,0 +1,36 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include "product/productcache.h"
+
+namespace QuantScript {
+	// A cache of two entries: a hit moves a key to the front so the least recently used one is
+	// evicted on the next miss, shrinking the capacity evicts from the back, and the counters
+	// count every hit, miss and eviction until clear()
+	inline bool test_productcache() {
+		ProductCache cache(2);
+		size_t builds = 0;
+		auto get = [&](const std::string& key) {
+			return cache.get(key, [&]() { ++builds; return std::make_shared<const FlatAst>(); });
+		};
+
+		const auto a = get("A");
+		const auto b = get("B");
+		bool ok = get("A") == a && builds == 2;
+		// B is now the least recently used
+		get("C");
+		ok = ok && cache.size() == 2 && cache.evictions() == 1 && get("A") == a && builds == 3;
+		ok = ok && get("B") != b && builds == 4 && cache.evictions() == 2;
+		// Order is now B, A, C was evicted
+		ok = ok && get("A") == a && builds == 4;
+		cache.setCapacity(1);
+		ok = ok && cache.capacity() == 1 && cache.size() == 1 && cache.evictions() == 3 && get("A") == a && builds == 4;
+		ok = ok && cache.hits() == 4 && cache.misses() == 4;
+
+		cache.clear();
+		ok = ok && cache.size() == 0 && cache.hits() == 0 && cache.misses() == 0 && cache.evictions() == 0 &&
+			get("A") != a && builds == 5;
+		std::cout << "product cache " << (ok ? "OK" : "FAILED") << std::endl;
+		return ok;
+	};
+}
@@ -0,0 +1,58 @@
+#include <cmath>
+#include <iostream>
+#include <map>
+#include "product/product.h"
+#include "product/scriptsolver.h"
+#include "models/mrg32k3a.h"
+
+namespace QuantScript {
+	// Solves the par coupon of a quarterly bond and the strike of a call worth 5, checks
+	// that the Newton steps converge within 2 and 5 evaluations and that revaluing the
+	// bond with the root written in its SOLVE() nodes gives par on the same paths
+	inline bool test_solver(const unsigned numSim = 10000) {
+		Date today(1, QuantLib::January, 2020);
+		SimpleBlackScholes<double> model(today, 100.0, 0.2, 0.03);
+		Mrg32k3aGen random;
+
+		std::map<Date, std::string> bond = {
+			{today + 90, "bnd pays 0.25 * SOLVE()"},
+			{today + 180, "bnd pays 0.25 * SOLVE()"},
+			{today + 270, "bnd pays 0.25 * SOLVE()"},
+			{today + 360, "bnd pays 1 + 0.25 * SOLVE()"} };
+		Product prd;
+		prd.parseEvents(bond.begin(), bond.end());
+		prd.indexVariables();
+		ScriptSolverSettings settings;
+		settings.guess = 0.1;
+		settings.tolerance = 1.0e-10;
+		ScriptSolverResult par = solveScript(prd, model, random, numSim, "BND", 1.0, settings);
+		std::cout << "par coupon " << par.root << " in " << par.evaluations << " evaluations" << std::endl;
+
+		auto mdl = model.clone();
+		auto rng = random.clone();
+		ScriptSimulator<double> simulator(*mdl, *rng);
+		simulator.initForScripting(prd.eventDates());
+		auto scenario = prd.buildScenario<double>();
+		auto evaluator = prd.buildEvaluator<double>();
+		double value = 0.0;
+		for (unsigned i = 0; i < numSim; ++i) {
+			simulator.nextScenario(*scenario);
+			evaluator->init();
+			prd.evaluate(*scenario, *evaluator);
+			value += evaluator->variables()[targetIndex(prd, "BND")];
+		}
+		value /= numSim;
+
+		std::map<Date, std::string> call = { {today + 360, "c pays max(spot() - SOLVE(), 0)"} };
+		Product option;
+		option.parseEvents(call.begin(), call.end());
+		option.indexVariables();
+		settings.guess = 100.0;
+		settings.lower = 0.0;
+		ScriptSolverResult strike = solveScript(option, model, random, numSim, "C", 5.0, settings);
+		std::cout << "strike " << strike.root << " in " << strike.evaluations << " evaluations" << std::endl;
+
+		return par.converged && par.evaluations <= 2 && std::fabs(value - 1.0) < 1.0e-8 &&
+			strike.converged && strike.evaluations <= 5;
+	};
+}
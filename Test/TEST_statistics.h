@@ -0,0 +1,49 @@
+#include <cmath>
+#include <iostream>
+#include <map>
+#include "product/product.h"
+#include "product/parallelval.h"
+#include "product/statistics.h"
+#include "models/pathstore.h"
+#include "models/mrg32k3a.h"
+
+namespace QuantScript {
+	// Prices a call on a PathStore with parallelScriptVal, recomputes the mean and the
+	// standard error of its payoffs in two passes over the same paths and checks that the
+	// merged Welford accumulators agree with them
+	inline bool test_statistics(const size_t numSim = 10000) {
+		Date today(1, QuantLib::January, 2020);
+		std::map<Date, std::string> events = { {today + 360, "opt pays max(spot() - 100, 0)"} };
+		Product prd;
+		prd.parseEvents(events.begin(), events.end());
+		prd.indexVariables();
+		SimpleBlackScholes<double> model(today, 100.0, 0.2, 0.03);
+		Mrg32k3aGen random;
+		const PathStore paths(model, random, prd.eventDates(), numSim);
+		const PathStatistics stats = parallelScriptVal(prd, paths, 37);
+
+		const std::vector<size_t> indices = paths.indicesOf(prd.eventDates());
+		Scenario<double> scenario(prd.eventDates().size());
+		auto evaluator = prd.buildEvaluator<double>();
+		std::vector<double> payoffs(numSim);
+		double mean = 0.0;
+		for (size_t p = 0; p < numSim; ++p) {
+			paths.load(p, indices, scenario);
+			evaluator->init();
+			prd.evaluate(scenario, *evaluator);
+			payoffs[p] = evaluator->variables()[0];
+			mean += payoffs[p];
+		}
+		mean /= numSim;
+		double variance = 0.0;
+		for (double x : payoffs)
+			variance += (x - mean) * (x - mean);
+		variance /= numSim - 1;
+		const double stdErr = std::sqrt(variance / numSim);
+
+		std::cout << "price " << stats.mean(0) << " +/- " << stats.standardError(0)
+			<< " over " << stats.count() << " paths" << std::endl;
+		return stats.count() == numSim && std::fabs(stats.mean(0) - mean) < 1.0e-12 * (1.0 + mean) &&
+			std::fabs(stats.standardError(0) - stdErr) < 1.0e-10 * stdErr;
+	};
+}